@@ -15,9 +15,77 @@ The 5 algorithms are:
 Usage:
 	Ensure that 'topology.dat' and 'callworkload.dat' are in the directory this program is running from.
     Compile the program using:
-        g++ routing.cpp
+        g++ -O2 -pthread routing.cpp
     Run the program using:
         ./a.out
+    Compile with -DROUTING_COUNTERS to count the work of each run (search pops and relaxations, departures
+    per reclaim, peak active calls, per-link peak utilization); the counters are printed to stderr after
+    the results. Without it the counting compiles to nothing.
+
+Options:
+    --topology FILE     topology file (default topology.dat)
+    --workload FILE     call workload file, '-' for stdin (default callworkload.dat). Give it more than once to
+                        merge several sorted workloads (e.g. the logs of several collectors) by arrival time
+    --stream            parse calls on the fly instead of loading the whole workload;
+                        only active calls are kept in memory. e.g.
+                            zcat trace.gz | ./a.out --stream --workload - --policy SHPF
+    --policy NAME       run only one of SHPF, SDPF, LLP, MFC, SHPO
+    --kpaths K          SHPF and SDPF first try the K shortest loopless paths of each pair (precomputed on
+                        the empty network), and search only if none has a free circuit on every link
+    --threads N         worker threads for the runs (default: one per hardware thread)
+    --sweep-capacity X,Y,..
+    --sweep-load X,Y,..
+                        replay the workload once per scenario, with link capacities (or arrival rates)
+                        scaled by each factor, and print one table of blocking probability per policy
+                        per scenario. Both lists together sweep every combination
+    --generate CALLS    replace the workload with CALLS synthetic calls generated on the fly: Poisson arrivals
+                        at --rate R per minute (default 1), holding times of mean --holding MEAN minutes
+                        (default 10), exponential or Pareto with --pareto SHAPE (> 1). Pairs are uniform,
+                        or weighted by --matrix FILE with lines "source destination weight"
+    --replications N    with --generate, run N independent replications (seeds from --seed S) in parallel
+                        and report the mean and 95% confidence interval of each statistic
+    --bench RUNS        time RUNS runs of each selected policy, one at a time, and report load time, calls/s,
+                        mean and p99 per-call routing latency, reclaim time and the peak RSS of each run, as text or
+                        with --bench-format json|csv
+    --make-topology KIND SIZE FILE
+                        write a benchmark topology of SIZE nodes: grid, geometric (random geometric),
+                        ba (Barabasi-Albert, --attach M links per node) or fattree (SIZE = port count k).
+                        Capacities and delays are uniform over --link-capacity MIN,MAX (default 10,50)
+                        and --link-delay MIN,MAX (default 1,100)
+    --make-workload CALLS FILE
+                        write CALLS calls for the topology to FILE, generated as for --generate
+    --window MINUTES --window-out FILE
+                        also write the blocking rate, carried load (mean calls in progress) and mean hops and
+                        delay of every MINUTES of simulated time to FILE as CSV, one row per run per window,
+                        flushed as each window closes (FILE may be a named pipe to watch runs live)
+    --sort-workload OUT write the calls of the --workload files, in any order, to OUT sorted by arrival time and
+                        exit. Sorts runs of --sort-memory CALLS lines (default 1000000) in memory and merges them
+                        from temporary files OUT.run*, up to 64 at a time, so traces larger than memory can be sorted
+    --shards N          split the network into N regions of about equal size (at most one per node), and run
+                        each replay with the regions routing the calls inside them over their own links, in
+                        parallel on up to --threads threads. Calls between regions are routed over the whole
+                        network, with the regions synchronized up to each such arrival (see simulateSharded)
+    --regions FILE      as --shards, with the region of each node read from FILE ("node region" lines; any
+                        non-negative region ids, numbered densely in id order)
+    --batch N           route arrivals in batches of up to N: the searches of a batch run in parallel on the
+                        network as the batch starts, and the calls commit in arrival order, with only those
+                        whose search a commit could have changed routed again. Same results as unbatched
+    --engine NAME       route searches over adjacency lists (sparse), or over node-by-node matrices with a
+                        vectorized scan (dense, best for small dense topologies). The default, auto, picks
+                        dense for topologies of up to 512 nodes with at least a fifth of all pairs linked,
+                        in builds with AVX2 or NEON (e.g. g++ -O2 -mavx2). Both give the same routes.
+                        Topologies of up to 64 nodes get a dense search compiled for their exact size
+    --checkpoint CALLS PREFIX
+                        every CALLS calls, each run snapshots its network, calls in progress, statistics and
+                        workload position to PREFIX.POLICY (replacing the last snapshot)
+    --resume PREFIX     continue each run from its snapshot PREFIX.POLICY, with the same options that wrote it;
+                        the results are those of an uninterrupted run. Streamed stdin cannot be resumed.
+                        The --window-out file keeps its rows up to each snapshot and continues from there
+    --fork SNAPSHOT     start every run from one snapshot, e.g. a warmed-up network for what-if policy runs:
+                            ./a.out --policy SHPF --checkpoint 50000 warm; ./a.out --fork warm.SHPF
+    --convert WORKLOAD TRACE
+                        convert a text workload to a binary call trace and exit. A binary trace given to
+                        --workload is recognised by its header and read in place from a memory map
 
 
 
@@ -43,7 +111,27 @@ Rachel Mclean- TA, University of Calgary
 #include <algorithm>
 #include <iterator>
 #include <iomanip>
+#include <sstream>
 #include <cstring>
+#include <queue>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <deque>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <chrono>
+#include <unordered_map>
+#include <climits>
+#include <charconv>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 using namespace std;
 
 
@@ -52,17 +140,58 @@ using namespace std;
 
 
 
+//list of link ids held by a routed call; short paths live inline, longer ones spill to the heap
+class PathRecord
+{
+    public:
+        static const int INLINE_LINKS = 8;
+
+        int size() const
+        {
+            return length;
+        }
+
+        int operator[](int i) const
+        {
+            return (i < INLINE_LINKS) ? inlineLinks[i] : spill[i - INLINE_LINKS];
+        }
+
+        void push(int link)
+        {
+            if(length < INLINE_LINKS)
+                inlineLinks[length] = link;
+            else
+                spill.push_back(link);
+            length++;
+        }
+
+        //empty the record; spill storage is kept for the next path held in it
+        void clear()
+        {
+            length = 0;
+            spill.clear();
+        }
+
+    private:
+        int length = 0;
+        int inlineLinks[INLINE_LINKS]{};
+        vector<int> spill;
+};
+
+
+
+
 //store individual event from call file
 class CallEvent
 {
     public:
-        double startTime;
-        double duration;
-        double endTime;
-        int source;
-        int destination;
-        bool running = false;
-        int resources[26][26]{};
+        double startTime = 0;
+        double duration = 0;
+        double endTime = 0;
+        int source = 0;
+        int destination = 0;
+
+        CallEvent() {}
 
         CallEvent(double s, double d, int sr, int dst)
         {
@@ -71,1016 +200,4894 @@ class CallEvent
             endTime = s+d;
             source = sr;
             destination = dst;
-            running = false;
         }
+};
 
-        void reset()
+
+
+
+//a routed call that still holds network resources
+class ActiveCall
+{
+    public:
+        PathRecord path;        //links currently held by this call
+};
+
+//when the active call in a CallPool slot ends
+class Departure
+{
+    public:
+        double endTime;
+        int slot;
+
+        Departure(double t, int s) : endTime(t), slot(s) {}
+
+        //order for the departure heap: the call ending latest sinks
+        bool operator>(const Departure &other) const
         {
-            running = false;
+            return endTime > other.endTime;
+        }
+};
 
-            for (int i = 0; i < 26; i++)
+//storage of the active calls of a run. Slots of departed calls go on a free list and are handed to new arrivals
+//with their path storage, so the pool grows only to the peak number of calls in progress and allocates
+//nothing once it gets there
+class CallPool
+{
+    public:
+        //a slot for a new call, with an empty path
+        int acquire()
+        {
+            if(freeSlots.empty())
             {
-                for (int j = 0; j < 26; j++)
-                    resources[i][j] = 0;
-            } 
+                slots.emplace_back();
+                return slots.size() - 1;
+            }
+            int s = freeSlots.back();
+            freeSlots.pop_back();
+            slots[s].path.clear();
+            return s;
+        }
+
+        void release(int s)
+        {
+            freeSlots.push_back(s);
         }
+
+        ActiveCall &operator[](int s)
+        {
+            return slots[s];
+        }
+
+    private:
+        vector<ActiveCall> slots;
+        vector<int> freeSlots;
 };
 
 
 
 
+//read-only view of an input file, one line at a time. Regular files are memory-mapped;
+//stdin and pipes are read in large chunks. Lines are returned without their newline
+class LineReader
+{
+    public:
+        LineReader() {}
+        LineReader(const LineReader &) = delete;
+        LineReader &operator=(const LineReader &) = delete;
 
+        ~LineReader()
+        {
+            close();
+        }
 
-//Global arrays- index # represents node #
-float propDelay[26][26]{};      //propogation for edges between nodes
-float capacity[26][26]{};         //total capacity on each edge. Immutable
-float availCap[26][26]{};         //available capacity on each edge
-float cost[26][26]{};           //updates with the cost of edges based on the currently chosen algorithm
-vector<CallEvent> eventQueue;
+        //start reading path ("-" is stdin)
+        bool open(const string &path)
+        {
+            close();
+            fileName = path;
+            line = 0;
+            consumed = 0;
+            readError = false;
+            fd = (path == "-") ? 0 : ::open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+                return false;
+
+            //map regular files whole
+            struct stat info;
+            if(fd != 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+            {
+                void *m = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(m != MAP_FAILED)
+                {
+                    madvise(m, info.st_size, MADV_SEQUENTIAL);
+                    mapped = (const char *)m;
+                    mappedSize = info.st_size;
+                    pos = mapped;
+                    limit = mapped + mappedSize;
+                    return true;
+                }
+            }
 
-//statistics
-double blockedCalls = 0;
-double succCalls = 0;
-double totalSuccCalls = 0;
-double totalCalls = 0;
-double totalHops = 0;
-double totalProp = 0;
+            //otherwise read in chunks
+            buffer.resize(CHUNK);
+            pos = limit = buffer.data();
+            atEnd = false;
+            return true;
+        }
 
-double blockedPercent = 0;
-double succPercent = 0;
-double avgHop = 0;
-double avgProp = 0;
+        //fetch the next line as [begin, end); false at end of file
+        bool next(const char *&begin, const char *&end)
+        {
+            const char *newline = (const char *)memchr(pos, '\n', limit - pos);
+            while(newline == NULL && !mapped && !atEnd)
+            {
+                refill();
+                newline = (const char *)memchr(pos, '\n', limit - pos);
+            }
 
+            if(pos == limit)
+                return false;
 
+            begin = pos;
+            end = (newline == NULL) ? limit : newline;
+            pos = (newline == NULL) ? limit : newline + 1;
+            line++;
 
-//clear values for next algorithm use
-void clearValues()
-{
-    blockedCalls = 0;
-    succCalls = 0;
-    totalSuccCalls = 0;
-    totalHops = 0;
-    totalProp = 0;
+            //tolerate CRLF line endings
+            if(end > begin && end[-1] == '\r')
+                end--;
+            return true;
+        }
 
-    blockedPercent = 0;
-    succPercent = 0;
-    avgHop = 0;
-    avgProp = 0;
+        //number of the line last returned, counting from 1
+        long lineNumber() const
+        {
+            return line;
+        }
 
-    memcpy(availCap, capacity, 26*26*sizeof(int));
+        //byte offset of the next line in the file
+        uint64_t offset() const
+        {
+            return mapped ? pos - mapped : consumed - (limit - pos);
+        }
 
-    //empty event attributes
-    for(int i = 0; i < eventQueue.size(); i++)
-        eventQueue[i].reset();
+        //continue reading at byte offset at, the start of line lineNumber() + 1. Mapped files only
+        bool seek(uint64_t at, long lineNumber)
+        {
+            if(!mapped || at > mappedSize)
+                return false;
+            pos = mapped + at;
+            line = lineNumber;
+            return true;
+        }
 
-    memset(cost, 0, sizeof(cost[0][0]) * 26 * 26);
+        const string &name() const
+        {
+            return fileName;
+        }
 
+        //true if reading stopped on an error rather than at the end of the file
+        bool failed() const
+        {
+            return readError;
+        }
 
-}
+    private:
+        static const size_t CHUNK = 1 << 20;
 
+        //move the unread tail to the front of the buffer and read more after it
+        void refill()
+        {
+            size_t tail = limit - pos;
+            if(tail == buffer.size())
+                buffer.resize(buffer.size() * 2);       //a line longer than the buffer
+            memmove(buffer.data(), pos, tail);
 
-//printer function for debugging; takes in 2D array and prints its elements
-void pr(int (&ar)[26][26])
-{
-    int l = 65;
-    int n = 65;
-    int flag = 0;
-    for (int k = 0; k < 26; k++)
-    {
-                    if ( k== 0)
-                    {  
-                        cout << "\t";
-                        while(l <= (65+25) )
-                        {
-                            cout << (char)l << "\t";
-                            l++;
-                        }       
-                     }
-            cout << endl;
-            for (int m = 0; m < 26; m++)
+            ssize_t got = read(fd, buffer.data() + tail, buffer.size() - tail);
+            if(got <= 0)
             {
-                        if(m == 0 && flag == 0)
-                        {   
-                                    if(n <= (65+25) )
-                                    {
-                                        cout << (char)n << "\t";
-                                        n++;
-                                        flag = 1;
-                                    }
-                        }
-
-                        if(m == 25)
-                            flag = 0;
-
-                        if ( k == m)
-                             cout << "//" << "\t";
-
-                        else
-                            cout << ar[k][m] << "\t";
+                readError = (got < 0);
+                got = 0;
+                atEnd = true;
             }
-    }
-}//end printer
-
-
+            consumed += got;
+            pos = buffer.data();
+            limit = pos + tail + got;
+        }
 
+        void close()
+        {
+            if(mapped)
+                munmap((void *)mapped, mappedSize);
+            if(fd > 0)
+                ::close(fd);
+            mapped = NULL;
+            fd = -1;
+        }
 
+        string fileName;
+        int fd = -1;
+        const char *mapped = NULL;
+        size_t mappedSize = 0;
+        vector<char> buffer;
+        bool atEnd = true;
+        bool readError = false;
+        const char *pos = NULL;
+        const char *limit = NULL;
+        long line = 0;
+        uint64_t consumed = 0;      //bytes read into buffer so far
+};
 
 
 
 
+//split off the next whitespace separated field of [pos, end) into [fieldBegin, fieldEnd); false if none is left
+inline bool nextField(const char *&pos, const char *end, const char *&fieldBegin, const char *&fieldEnd)
+{
+    while(pos < end && (*pos == ' ' || *pos == '\t'))
+        pos++;
+    if(pos == end)
+        return false;
 
+    fieldBegin = pos;
+    while(pos < end && *pos != ' ' && *pos != '\t')
+        pos++;
+    fieldEnd = pos;
+    return true;
+}
 
+//parse a whole field as a number; false if it is not one
+template <class T>
+inline bool parseNumber(const char *begin, const char *end, T &value)
+{
+    if(begin < end && *begin == '+')
+        begin++;
+    from_chars_result r = from_chars(begin, end, value);
+    return r.ec == errc() && r.ptr == end;
+}
 
-//print titles
-void printInit()
+//split a line into exactly count fields; false if it has fewer or more
+inline bool splitFields(const char *begin, const char *end, int count, const char **fieldBegin, const char **fieldEnd)
 {
-    printf("%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\n%-12s\n",
-        "Policy","Total Calls","Successful","Success(%)","Blocked", "Blocked(%)", "Avg Hops(ms)", "Avg Delay",
-        "=========================================================================================================================");
+    for (int f = 0; f < count; f++)
+    {
+        if(!nextField(begin, end, fieldBegin[f], fieldEnd[f]))
+            return false;
+    }
+    const char *extraBegin, *extraEnd;
+    return !nextField(begin, end, extraBegin, extraEnd);
 }
 
-//print resulting stats
-void printRes(const char *s)
+//true if the line holds nothing but whitespace
+inline bool blankLine(const char *begin, const char *end)
 {
-    printf("%-12s\t%-12.0f\t%-12.0f\t%-12.2f\t%-12.0f\t%-12.2f\t%-12.4f\t%-12.4f\n",
-       s, totalCalls, succCalls, succPercent, blockedCalls, blockedPercent, avgHop, avgProp);
+    const char *fieldBegin, *fieldEnd;
+    return !nextField(begin, end, fieldBegin, fieldEnd);
+}
 
+//report a malformed input line and stop
+void inputError(const LineReader &in, const string &message)
+{
+    cerr << in.name() << ":" << in.lineNumber() << ": " << message << endl;
+    exit(1);
 }
 
 
 
 
+//Binary call trace. Layout, in native byte order:
+//    TraceHeader
+//    callCount TraceRecords, in arrival order
+//    node name table at nameOffset: nodeCount names, each a uint32_t length followed by its characters
+//Record node ids index the trace's own name table; readers map them to topology nodes by name
+const char TRACE_MAGIC[8] = {'R','T','S','T','R','A','C','E'};
+const uint32_t TRACE_VERSION = 1;
 
-//recover resources for finished calls
-void timeUpdate(int currentIndex)
+class TraceHeader
 {
-    //for all events
-    for (int j = 0; j < currentIndex ; j++)
-    {
-        //that are running
-        if (eventQueue.at(j).running)
-        {
-            //if the event has an end time <= then current events start time, then end that event
-            if(eventQueue.at(j).endTime <= eventQueue.at(currentIndex).startTime )
-            {
-                //end event
-                eventQueue.at(j).running = false;
-
-                //reclaim that events resources
-                for (int k = 0; k < 26; k++)
-                {
-                    for (int m = 0; m < 26; m++)
-                    {   
-                        //remove accumulated resources from finished event, and place it back in available capacity array
-                        if(eventQueue.at(j).resources[k][m] > 0)
-                        {
-                            availCap[k][m] = availCap[m][k]
-                                    += eventQueue.at(j).resources[k][m];    
-                            eventQueue.at(j).resources[k][m]
-                                    = eventQueue.at(j).resources[m][k] = 0;
-                        }
-                    }    
-                }
-            }
-        }
-    }
-}
+    public:
+        char magic[8];
+        uint32_t version;
+        uint32_t nodeCount;
+        uint64_t callCount;
+        uint64_t nameOffset;
+};
 
+class TraceRecord
+{
+    public:
+        double startTime;
+        double duration;
+        uint32_t source;
+        uint32_t destination;
+};
 
 
 
 
-//update cost array associated with SHPF algorithm
-void updateSHPF()
+//true if path starts like a binary call trace
+bool isBinaryTrace(const string &path)
 {
-    //init costs to 1 for SHPF cost array
-    for (int k = 0; k < 26; k++)
-    {
-        for (int m = 0; m < 26; m++)
-        {
-            if(availCap[k][m] > 0)
-            {
-                cost[k][m] = 1;
-                cost[m][k] = 1;
-            }
-            else
-            {
-                cost[k][m] = 0;
-                cost[m][k] = 0;
-            }
-        }
-        
-    }
-
+    char magic[sizeof(TRACE_MAGIC)];
+    FILE *f = (path == "-") ? NULL : fopen(path.c_str(), "rb");
+    if(f == NULL)
+        return false;
+    bool binary = (fread(magic, 1, sizeof(magic), f) == sizeof(magic)) && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+    fclose(f);
+    return binary;
 }
 
 
 
 
-//update edge costs for LLP algorithm
-void updateLLP()
+//memory-mapped binary call trace, iterated in place
+class BinaryTrace
 {
+    public:
+        BinaryTrace() {}
+        BinaryTrace(const BinaryTrace &) = delete;
+        BinaryTrace &operator=(const BinaryTrace &) = delete;
 
-    for (int k = 0; k < 26; k++)
-    {
-        for (int m = 0; m < 26; m++)
+        ~BinaryTrace()
         {
-            cost[k][m] = 1-((float)(availCap[k][m]) / (float)(capacity[k][m]));
+            close();
         }
-        
-    }
-}
-
-
 
+        //map path and check its header and name table; exits on a damaged trace. Records are checked as
+        //they are read (see WorkloadReader)
+        bool open(const string &path)
+        {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+                return false;
 
-//update edge costs for MFC algorithm
-void updateMFC()
-{
+            struct stat info;
+            if(fstat(fd, &info) == 0 && info.st_size >= sizeof(TraceHeader))
+            {
+                void *m = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(m != MAP_FAILED)
+                {
+                    mapped = (const char *)m;
+                    mappedSize = info.st_size;
+                }
+            }
+            ::close(fd);
+            if(!mapped)
+                return false;
+
+            //check header and sizes before trusting any offset
+            const TraceHeader &h = header();
+            if(memcmp(h.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || h.version != TRACE_VERSION)
+                traceError(path, "not a version " + to_string(TRACE_VERSION) + " binary call trace");
+            if(h.callCount > (mappedSize - sizeof(TraceHeader)) / sizeof(TraceRecord)
+                    || h.nameOffset < sizeof(TraceHeader) + h.callCount * sizeof(TraceRecord) || h.nameOffset > mappedSize)
+                traceError(path, "truncated binary call trace");
+
+            //node name table
+            names.clear();
+            size_t at = h.nameOffset;
+            for (uint32_t n = 0; n < h.nodeCount; n++)
+            {
+                uint32_t length;
+                if(at + sizeof(length) > mappedSize)
+                    traceError(path, "truncated node name table");
+                memcpy(&length, mapped + at, sizeof(length));
+                at += sizeof(length);
+                if(length > mappedSize - at)
+                    traceError(path, "truncated node name table");
+                names.push_back( string(mapped + at, length) );
+                at += length;
+            }
+            return true;
+        }
 
-    for (int k = 0; k < 26; k++)
-    {
-        for (int m = 0; m < 26; m++)
+        const TraceHeader &header() const
         {
-            cost[k][m] = ((float)(availCap[k][m]) / (float)(capacity[k][m]));
+            return *(const TraceHeader *)mapped;
         }
-        
-    }
-}
 
+        const TraceRecord &record(uint64_t i) const
+        {
+            return ((const TraceRecord *)(mapped + sizeof(TraceHeader)))[i];
+        }
 
+        uint64_t size() const
+        {
+            return header().callCount;
+        }
 
+        //name table of the trace (index- trace node id)
+        vector<string> names;
 
+    private:
+        static void traceError(const string &path, const string &message)
+        {
+            cerr << path << ": " << message << endl;
+            exit(1);
+        }
 
-//determine the minimal entry in an array and return the index of it
-int minDistVertexInQueue( int dist[26], int queue[26])
-{
-    int minVal = 999;       //infinity
-    int minIndex = 50;      //infinity index
-    for (int i = 0; i < 26; i++)
-    {
-        //if node is unvisited, and distance of that node is 
-        if( (queue[i] == 1) && (dist[i] < minVal) )
+        void close()
         {
-            minVal = dist[i];
-            minIndex = i;
-        }      
-    }
+            if(mapped)
+                munmap((void *)mapped, mappedSize);
+            mapped = NULL;
+        }
 
-    return minIndex;
-}
+        const char *mapped = NULL;
+        size_t mappedSize = 0;
+};
 
 
 
 
+int findNode(const string &name);
 
-//run djikstras algorithm on a Graph between 2 points, and provided edge weights FOR SHPO
-int emptySHPO(int source, int destination, float (&edgeCost)[26][26], float (&capZero)[26][26], int current)
+//where a WorkloadReader is in its workload: the byte offset and line number of the next line of a text
+//workload, or the next record of a binary trace. Kept in checkpoints
+class StreamPosition
 {
+    public:
+        uint64_t offset = 0;
+        int64_t line = 0;
+        double lastStart = 0;
+};
 
-    //initialize queue of vertices
-    //      (elem=1: index is a vertex in queue; elem=0: index is a vertex not in queue)
-    int queue[26]{};
-    int size = 0;  //queue size
-    
-    //initialize previous vertex for path tracking
-    //  (index- the vertex; elem- the previous vertex of the index vertex)
-    int previousVertex[26]{};
-    int dist[26]{};
-
-    for (int i = 0; i < 26; i++)
-    {
-        //initialize distance from each vertex to source to INF (index= vertex; elem=distance to it)
-        dist[i] = 999;
-
-        //init all prev vertex(element) or a vertex(index) to null
-        previousVertex[i] = -1;
-    }
-
-    //init queue to determine which vertices exist on empty net
-    for (int i = 0; i < 26; i++)
-    {
-        for (int j = 0; j < 26; j++)
+//reads calls from a workload file (or stdin) one at a time, in arrival order.
+//Text workloads are parsed line by line; binary traces are read straight from their mapping
+class WorkloadReader
+{
+    public:
+        //start reading path ("-" is stdin, which can only be read once). With checkOrder a call
+        //arriving before the previous one is an error; streamed runs need it, loaded workloads are sorted after
+        bool open(const string &path, bool checkOrder = true)
         {
-            if(capacity[i][j] > 0)
+            lastStart = 0;
+            ordered = checkOrder;
+            binary = isBinaryTrace(path);
+            if(!binary)
+                return in.open(path);
+            tracePath = path;
+
+            if(!trace.open(path))
+                return false;
+            nextRecord = 0;
+
+            //trace node ids to topology node ids
+            traceNodes.resize(trace.names.size());
+            for (int n = 0; n < trace.names.size(); n++)
             {
-                if(queue[i] == 0)
+                traceNodes[n] = findNode(trace.names[n]);
+                if(traceNodes[n] < 0)
                 {
-                    queue[i] = 1;
-                    size = size+1;
-
+                    cerr << path << ": node " << trace.names[n] << " is not in the topology" << endl;
+                    exit(1);
                 }
-                    
             }
+            return true;
         }
-        
-    }
-
-    //set source vertex's distance as 0
-    dist[source] = 0;
-
-    int foundFlag = 0;
-
 
+        //parse the next call; false at end of workload
+        bool next(CallEvent &call)
+        {
+            if(binary)
+            {
+                if(nextRecord >= trace.size())
+                    return false;
+                uint64_t i = nextRecord++;
+                const TraceRecord &r = trace.record(i);
+                if(r.source >= traceNodes.size() || r.destination >= traceNodes.size())
+                    recordError(i, "node id is not in the trace's name table");
+                if(ordered && r.startTime < lastStart)
+                    recordError(i, "call arrives before the previous call (sort the workload with --sort-workload)");
+                lastStart = r.startTime;
+                call = CallEvent(r.startTime, r.duration, traceNodes[r.source], traceNodes[r.destination]);
+                return true;
+            }
 
-    //run djikstra's algorithm on empty network to determine hops
-    while(size > 0 )
-    {
-        //determine which vertex(index) in queue has the current minimum distance
-        int u = minDistVertexInQueue(dist, queue);
+            const char *begin, *end;
+            do
+            {
+                if(!in.next(begin, end))
+                    return false;
+            } while(blankLine(begin, end));
+
+            //time source destination duration
+            const char *fieldBegin[4], *fieldEnd[4];
+            double a,d;
+            if(!splitFields(begin, end, 4, fieldBegin, fieldEnd)
+                    || !parseNumber(fieldBegin[0], fieldEnd[0], a) || !parseNumber(fieldBegin[3], fieldEnd[3], d))
+                inputError(in, "expected 'time source destination duration'");
+
+            if(ordered && a < lastStart)
+                inputError(in, "call arrives before the previous call (sort the workload with --sort-workload)");
+            lastStart = a;
+
+            key.assign(fieldBegin[1], fieldEnd[1]);
+            int b = findNode(key);
+            if(b < 0)
+                inputError(in, "node " + key + " is not in the topology");
+            key.assign(fieldBegin[2], fieldEnd[2]);
+            int c = findNode(key);
+            if(c < 0)
+                inputError(in, "node " + key + " is not in the topology");
+
+            call = CallEvent(a, d, b, c);
+            return true;
+        }
 
-        //stop searching  if landed in terminal of a forest
-        if( u > 27)
+        StreamPosition position() const
         {
-            break;
+            StreamPosition at;
+            at.offset = binary ? nextRecord : in.offset();
+            at.line = binary ? 0 : in.lineNumber();
+            at.lastStart = lastStart;
+            return at;
         }
 
-        //remove vertex u from queue
-        queue[u] = 0;
+        //continue from a position() of the same workload; false if it cannot be reached (stdin, pipes)
+        bool seek(const StreamPosition &at)
+        {
+            lastStart = at.lastStart;
+            if(!binary)
+                return in.seek(at.offset, at.line);
+            if(at.offset > trace.size())
+                return false;
+            nextRecord = at.offset;
+            return true;
+        }
 
-        //stop searching if destination vertex found
-        if(u == destination)
+    private:
+        //report a damaged record i of the trace and exit, as inputError() does for text workloads
+        void recordError(uint64_t i, const string &message) const
         {
-            foundFlag = 1;
-            break;
+            cerr << tracePath << ": record " << i + 1 << ": " << message << endl;
+            exit(1);
         }
 
-        //decrease size of queue
-        size = size-1;
+        LineReader in;
+        string key;             //node name being looked up; reused so lookups do not allocate
+        double lastStart = 0;
+        bool ordered = true;    //reject out-of-order arrivals
+
+        bool binary = false;
+        string tracePath;
+        BinaryTrace trace;
+        uint64_t nextRecord = 0;  //next record of trace
+        vector<int> traceNodes; //(index- trace node id; elem- topology node id)
+};
 
 
 
 
-        //for all the vertices
-        for (int j = 0; j < 26; j++)
+//the calls of several workloads merged into one arrival stream in time order, each workload read
+//as it goes. Every workload must itself be sorted (see sortWorkload()); equal times go to the earlier file
+class ArrivalMerge
+{
+    public:
+        //open the workloads, at the positions() from (one per path) if given
+        bool open(const vector<string> &paths, const vector<StreamPosition> &from = vector<StreamPosition>())
         {
-            //other than 'u' that remain in the queue (aka are set to 1)
-            if(queue[j] > 0)
+            readers.clear();
+            heads.assign(paths.size(), CallEvent());
+            headAt.assign(paths.size(), StreamPosition());
+            heap = priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > >();
+            for (int r = 0; r < paths.size(); r++)
             {
-                //find out which ones(j) are neighbours of u
-
-                    //[u- current vertex from queue][j- its potential neighbour]
-                    if(capZero[u][j] > 0)
-                    {
-                        //determine distance to these neighbours from u
-                        int alt = dist[u] + edgeCost[u][j];
-
-                        //update distance of j from source, if its less than existing distance
-                        if(alt < dist[j])
-                        {
-                            dist[j] = alt;
-                            previousVertex[j] = u;  //the previous vertex of j is now the vertex u.
-                        }
-                    }
+                readers.emplace_back();
+                if(!readers[r].open(paths[r]))
+                    return false;
+                if(!from.empty() && !readers[r].seek(from[r]))
+                    return false;
+                headAt[r] = readers[r].position();
+                if(paths.size() > 1 && readers[r].next(heads[r]))
+                    heap.push( make_pair(heads[r].startTime, r) );
             }
+            return true;
         }
-          
 
-    }
-    //quit if no path was found
-    if(foundFlag != 1)
-    {
-        return 999; //hopPath 2 = infinity
-    }
-        
-    //determine hops for this run
-     int curr = destination;
-     int hopPath1 = 0; 
-
-    while(previousVertex[curr] > -1)
-    { 
-
-        //update total number of hops
-        hopPath1++;
-
-        curr = previousVertex[curr];
-    }
+        //the earliest call not yet returned; false once every workload is exhausted
+        bool next(CallEvent &call)
+        {
+            //a single workload needs no merging
+            if(readers.size() == 1)
+                return readers[0].next(call);
+
+            if(heap.empty())
+                return false;
+            int r = heap.top().second;
+            heap.pop();
+            call = heads[r];
+            headAt[r] = readers[r].position();
+            if(readers[r].next(heads[r]))
+                heap.push( make_pair(heads[r].startTime, r) );
+            return true;
+        }
 
-    return hopPath1;
+        //where each workload is, counting calls read ahead into heads as not yet read
+        vector<StreamPosition> positions() const
+        {
+            if(readers.size() == 1)
+                return vector<StreamPosition>(1, readers[0].position());
+            return headAt;
+        }
 
-} //end updateStateSHPO
+    private:
+        deque<WorkloadReader> readers;
+        vector<CallEvent> heads;    //next call of each reader
+        vector<StreamPosition> headAt;  //position of each reader before its head
+        priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > > heap;    //(time, reader) of the heads
+};
 
 
 
 
-//run djikstras algorithm on a Graph between 2 points, and provided edge weights
-bool updateState(int source, int destination, float (&edgeCost)[26][26], int current)
+//convert a text workload to a binary call trace; returns the exit status
+int convertTrace(const string &inPath, const string &outPath)
 {
-
-    //initialize queue of vertices
-    //      (elem=1: index is a vertex in queue; elem=0: index is a vertex not in queue)
-    int queue[26]{};
-    int size = 0;  //queue size
-
-    //initialize previous vertex for path tracking
-    //  (index- the vertex; elem- the previous vertex of the index vertex)
-    int previousVertex[26]{};
-    int dist[26]{};
-
-    for (int i = 0; i < 26; i++)
+    LineReader in;
+    if(!in.open(inPath))
     {
-        //initialize distance from each vertex to source to INF (index= vertex; elem=distance to it)
-        dist[i] = 999;
-
-        //init all prev vertex(element) or a vertex(index) to null
-        previousVertex[i] = -1;
+        cerr << "error: cannot read " << inPath << endl;
+        return 1;
+    }
+    FILE *out = fopen(outPath.c_str(), "wb");
+    if(out == NULL)
+    {
+        cerr << "error: cannot write " << outPath << endl;
+        return 1;
     }
 
-    //init queue to determine which vertices exist in this run(1-exists, 0- not exists)
-    for (int i = 0; i < 26; i++)
+    //header is rewritten with the final counts once all records are out
+    TraceHeader h;
+    memcpy(h.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    h.version = TRACE_VERSION;
+    h.nodeCount = 0;
+    h.callCount = 0;
+    h.nameOffset = 0;
+    fwrite(&h, sizeof(h), 1, out);
+
+    //node names in order of first appearance
+    vector<string> names;
+    unordered_map<string,uint32_t> ids;
+    string key;
+    double lastStart = 0;
+    const char *begin, *end;
+
+    while(in.next(begin, end))
     {
-        for (int j = 0; j < 26; j++)
+        if(blankLine(begin, end))
+            continue;
+
+        const char *fieldBegin[4], *fieldEnd[4];
+        TraceRecord r;
+        if(!splitFields(begin, end, 4, fieldBegin, fieldEnd)
+                || !parseNumber(fieldBegin[0], fieldEnd[0], r.startTime) || !parseNumber(fieldBegin[3], fieldEnd[3], r.duration))
+            inputError(in, "expected 'time source destination duration'");
+        if(r.startTime < lastStart)
+            inputError(in, "call arrives before the previous call");
+        lastStart = r.startTime;
+
+        for (int f = 1; f <= 2; f++)
         {
-            if(availCap[i][j] > 0)
+            key.assign(fieldBegin[f], fieldEnd[f]);
+            unordered_map<string,uint32_t>::iterator it = ids.find(key);
+            if(it == ids.end())
             {
-                if(queue[i] == 0)
-                {
-                    queue[i] = 1;
-                    size = size+1;
-
-                }
-                    
+                it = ids.insert( make_pair(key, (uint32_t)names.size()) ).first;
+                names.push_back(key);
             }
+            (f == 1 ? r.source : r.destination) = it->second;
         }
-        
+
+        fwrite(&r, sizeof(r), 1, out);
+        h.callCount++;
     }
 
-    //set source vertex's distance as 0
-    dist[source] = 0;
+    //name table, then the final header
+    h.nodeCount = names.size();
+    h.nameOffset = sizeof(TraceHeader) + h.callCount * sizeof(TraceRecord);
+    for (int n = 0; n < names.size(); n++)
+    {
+        uint32_t length = names[n].size();
+        fwrite(&length, sizeof(length), 1, out);
+        fwrite(names[n].data(), 1, length, out);
+    }
+    fseek(out, 0, SEEK_SET);
+    fwrite(&h, sizeof(h), 1, out);
 
-    int foundFlag = 0;
+    if(ferror(out) | fclose(out))
+    {
+        cerr << "error: writing " << outPath << " failed" << endl;
+        return 1;
+    }
+    return 0;
+}
 
 
 
-    //run djikstra's algorithm
-    while(size > 0 )
-    {
-        //determine which vertex(index) in queue has the current minimum distance
-        int u = minDistVertexInQueue(dist, queue);
 
-        //stop searching  if landed in terminal of a forest
-        if( u > 27)
-        {
-            break;
-        }
+//arrival time of a workload line (its first field); false if it has none
+inline bool lineTime(const char *begin, const char *end, double &time)
+{
+    const char *fieldBegin, *fieldEnd;
+    return nextField(begin, end, fieldBegin, fieldEnd) && parseNumber(fieldBegin, fieldEnd, time);
+}
 
-        //remove vertex u from queue
-        queue[u] = 0;
+const int MERGE_FAN_IN = 64;    //most sorted runs merged at once (each holds a file open), fewer if the fd limit is low
 
-        //stop searching if destination vertex found
-        if(u == destination)
+//sort the calls of one or more text workloads by arrival time into outPath, holding at most runCalls lines
+//in memory: sorted runs of runCalls lines go to temporary files next to outPath, which are then merged.
+//Calls with equal times keep their input order. Returns the exit status
+int sortWorkload(const vector<string> &inPaths, const string &outPath, long runCalls)
+{
+    vector<string> runPaths;
+    string text;                                //lines of the current run, back to back
+    vector< tuple<double,size_t,int> > lines;   //(time, offset in text, length) of each
+    runCalls = max(runCalls, 1L);
+
+    //sort the current run and write it to path
+    auto writeRun = [&](const string &path) -> bool
+    {
+        stable_sort(lines.begin(), lines.end(),
+                    [](const tuple<double,size_t,int> &a, const tuple<double,size_t,int> &b) { return get<0>(a) < get<0>(b); });
+        FILE *out = fopen(path.c_str(), "w");
+        if(out == NULL)
+            return false;
+        for (int k = 0; k < lines.size(); k++)
         {
-            foundFlag = 1;
-            break;
+            fwrite(text.data() + get<1>(lines[k]), 1, get<2>(lines[k]), out);
+            fputc('\n', out);
         }
+        text.clear();
+        lines.clear();
+        return !(ferror(out) | fclose(out));
+    };
 
-        //decrease size of queue
-        size = size-1;
-
-
-
+    for (int f = 0; f < inPaths.size(); f++)
+    {
+        LineReader in;
+        if(!in.open(inPaths[f]))
+        {
+            cerr << "error: cannot read " << inPaths[f] << endl;
+            return 1;
+        }
 
-        //for all the vertices
-        for (int j = 0; j < 26; j++)
+        const char *begin, *end;
+        while(in.next(begin, end))
         {
-            //other than 'u' that remain in the queue (aka are set to 1)
-            if(queue[j] > 0)
+            if(blankLine(begin, end))
+                continue;
+            double time;
+            if(!lineTime(begin, end, time))
+                inputError(in, "expected 'time source destination duration'");
+
+            //drop a trailing carriage return so runs hold plain lines
+            const char *last = (end > begin && end[-1] == '\r') ? end - 1 : end;
+            lines.push_back( make_tuple(time, text.size(), (int)(last - begin)) );
+            text.append(begin, last);
+
+            if(lines.size() >= runCalls)
             {
-                //find out which ones(j) are neighbours of u
-
-                    //[u- current vertex from queue][j- its potential neighbour]
-                    if(availCap[u][j] > 0)
-                    {
-                        //determine distance to these neighbours from u
-                        int alt = dist[u] + edgeCost[u][j];
-
-                        //update distance of j from source, if its less than existing distance
-                        if(alt < dist[j])
-                        {
-                            dist[j] = alt;
-                            previousVertex[j] = u;  //the previous vertex of j is now the vertex u.
-                        }
-                    }
+                runPaths.push_back(outPath + ".run" + to_string(runPaths.size()));
+                if(!writeRun(runPaths.back()))
+                {
+                    cerr << "error: cannot write " << runPaths.back() << endl;
+                    return 1;
+                }
             }
         }
-          
-
     }
-    //quit if no path was found
-    if(foundFlag != 1)
+
+    //merge the sorted runs at paths into path, earliest head line first; equal times go to the earlier run.
+    //Fails if a run cannot be opened or read in full
+    auto mergeRuns = [](const vector<string> &paths, const string &path) -> bool
     {
-        return false;
-    }
-        
-                
-    //update topology state and statistics
-    int curr = destination; 
+        FILE *out = fopen(path.c_str(), "w");
+        if(out == NULL)
+        {
+            cerr << "error: cannot write " << path << endl;
+            return false;
+        }
+        deque<LineReader> runs;
+        vector<const char *> headBegin(paths.size()), headEnd(paths.size());
+        priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > > heap;
+        bool ok = true;
 
-    while(previousVertex[curr] > -1)
-    { 
-        //decrease available circuits for current link
-        availCap[curr][previousVertex[curr]] = --availCap[previousVertex[curr]][curr];
+        //queue the next line of run r
+        auto advance = [&](int r)
+        {
+            double time;
+            if(!runs[r].next(headBegin[r], headEnd[r]))
+            {
+                if(runs[r].failed())
+                {
+                    cerr << "error: cannot read " << paths[r] << endl;
+                    ok = false;
+                }
+                return;
+            }
+            if(!lineTime(headBegin[r], headEnd[r], time))
+            {
+                cerr << paths[r] << ":" << runs[r].lineNumber() << ": damaged run line" << endl;
+                ok = false;
+                return;
+            }
+            heap.push( make_pair(time, r) );
+        };
 
-        //update current events attained resources
-        eventQueue.at(current).resources[curr][previousVertex[curr]] = ++eventQueue.at(current).resources[previousVertex[curr]][curr];
-        
-        //update total propDelay
-        totalProp += propDelay[curr][previousVertex[curr] ];
+        for (int r = 0; r < paths.size() && ok; r++)
+        {
+            runs.emplace_back();
+            if(!runs[r].open(paths[r]))
+            {
+                cerr << "error: cannot read " << paths[r] << endl;
+                ok = false;
+                break;
+            }
+            advance(r);
+        }
+        while(ok && !heap.empty())
+        {
+            int r = heap.top().second;
+            heap.pop();
+            fwrite(headBegin[r], 1, headEnd[r] - headBegin[r], out);
+            fputc('\n', out);
+            advance(r);
+        }
+        runs.clear();
 
+        if(ferror(out) | fclose(out))
+        {
+            cerr << "error: writing " << path << " failed" << endl;
+            return false;
+        }
+        return ok;
+    };
 
-        //update loop iterator
-        curr = previousVertex[curr];
+    //everything fit in one run: no merge needed
+    if(runPaths.empty())
+    {
+        if(!writeRun(outPath))
+        {
+            cerr << "error: cannot write " << outPath << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if(!lines.empty())
+    {
+        runPaths.push_back(outPath + ".run" + to_string(runPaths.size()));
+        if(!writeRun(runPaths.back()))
+        {
+            cerr << "error: cannot write " << runPaths.back() << endl;
+            return 1;
+        }
+    }
 
-        //update total number of hops
-        totalHops++;
+    //merge passes of up to fanIn consecutive runs into new runs until one pass can write outPath.
+    //Leave a few descriptors for the output and stdio
+    int fanIn = MERGE_FAN_IN;
+    struct rlimit files;
+    if(getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur != RLIM_INFINITY)
+        fanIn = max(2, min<int>(fanIn, (int)files.rlim_cur - 8));
+    int runCount = runPaths.size();
+    while(runPaths.size() > fanIn)
+    {
+        vector<string> merged;
+        for (int first = 0; first < runPaths.size(); first += fanIn)
+        {
+            vector<string> group(runPaths.begin() + first, runPaths.begin() + min<int>(first + fanIn, runPaths.size()));
+            merged.push_back(outPath + ".run" + to_string(runCount++));
+            bool ok = mergeRuns(group, merged.back());
+            for (int r = 0; r < group.size(); r++)
+                unlink(group[r].c_str());
+            if(!ok)
+            {
+                for (int r = first + group.size(); r < runPaths.size(); r++)
+                    unlink(runPaths[r].c_str());
+                for (int r = 0; r < merged.size(); r++)
+                    unlink(merged[r].c_str());
+                return 1;
+            }
+        }
+        runPaths = merged;
     }
 
-    return true;
-            
+    bool ok = mergeRuns(runPaths, outPath);
+    for (int r = 0; r < runPaths.size(); r++)
+        unlink(runPaths[r].c_str());
+    if(!ok)
+    {
+        unlink(outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
 
 
-} //end updateState
 
 
 
 
+//Network- loaded once, then read-only and shared by all runs.
+//Node ids index nodeNames; link ids index the per-link arrays
+vector<string> nodeNames;               //name of each node (index- node id)
+unordered_map<string,int> nodeIndex;    //node id of each name
+vector< pair<int,int> > links;          //end nodes of each link (index- link id)
+vector<float> propDelay;                //propogation delay of each link
+vector<int> capacity;                   //total capacity of each link. Immutable
 
 
 
 
+//the loaded workload as packed per-field arrays (index- call number, in arrival order), so the
+//arrival loop streams only the fields it reads. Read-only during runs; routing state lives in each SimState
+class CallTrace
+{
+    public:
+        vector<double> startTime;
+        vector<double> endTime;
+        vector<int> source;
+        vector<int> destination;
 
+        int size() const
+        {
+            return startTime.size();
+        }
 
+        void push_back(const CallEvent &call)
+        {
+            startTime.push_back(call.startTime);
+            endTime.push_back(call.endTime);
+            source.push_back(call.source);
+            destination.push_back(call.destination);
+        }
 
+        //put the calls in arrival order; calls arriving together keep their order
+        void sortByArrival()
+        {
+            if(is_sorted(startTime.begin(), startTime.end()))
+                return;
+            vector<int> order(size());
+            for (int i = 0; i < order.size(); i++)
+                order[i] = i;
+            stable_sort(order.begin(), order.end(), [this](int a, int b) { return startTime[a] < startTime[b]; });
+
+            CallTrace sorted;
+            for (int i = 0; i < order.size(); i++)
+                sorted.push_back(at(order[i]));
+            *this = sorted;
+        }
 
+        //the i-th call
+        CallEvent at(int i) const
+        {
+            CallEvent call;
+            call.startTime = startTime[i];
+            call.endTime = endTime[i];
+            call.duration = endTime[i] - startTime[i];
+            call.source = source[i];
+            call.destination = destination[i];
+            return call;
+        }
+};
+CallTrace eventQueue;
 
+//adjacency lists in compressed sparse row form, built once the topology is loaded.
+//The links of node u are entries offset[u] .. offset[u+1]-1 of neighbour and link
+class Graph
+{
+    public:
+        vector<int> offset;
+        vector<int> neighbour;      //node at the other end
+        vector<int> link;           //link id
+        vector<int> slot;           //the two entries of link l: slot[2l] at its first end, slot[2l+1] at its second
+        vector<int> maskOffset;     //first 64-bit word of node u in a LinkMask
+
+        //build from the links table over nodes 0 .. nodes-1
+        void build(int nodes)
+        {
+            offset.assign(nodes+1, 0);
+            for (int l = 0; l < links.size(); l++)
+            {
+                offset[links[l].first+1]++;
+                offset[links[l].second+1]++;
+            }
+            for (int u = 0; u < nodes; u++)
+                offset[u+1] += offset[u];
+
+            neighbour.assign(offset[nodes], 0);
+            link.assign(offset[nodes], 0);
+            slot.assign(2 * links.size(), 0);
+            vector<int> fill(offset.begin(), offset.end()-1);
+            for (int l = 0; l < links.size(); l++)
+            {
+                int a = links[l].first;
+                int b = links[l].second;
+                slot[2*l] = fill[a];
+                neighbour[fill[a]] = b;
+                link[fill[a]++] = l;
+                slot[2*l+1] = fill[b];
+                neighbour[fill[b]] = a;
+                link[fill[b]++] = l;
+            }
 
+            //one bit per entry, each node starting on a new word
+            maskOffset.assign(nodes+1, 0);
+            for (int u = 0; u < nodes; u++)
+                maskOffset[u+1] = maskOffset[u] + (offset[u+1] - offset[u] + 63) / 64;
+        }
+};
+Graph graph;
 
+//a set of links kept as one packed bitset per node over its adjacency entries: bit e - offset[u] of
+//node u's words stands for entry e. Each link is recorded at both of its ends
+class LinkMask
+{
+    public:
+        vector<uint64_t> words;
 
-///Main function////////////////////////////////////////////
+        void reset()
+        {
+            words.assign(graph.maskOffset.back(), 0);
+        }
 
+        void set(int l)
+        {
+            setEntry(links[l].first, graph.slot[2*l]);
+            setEntry(links[l].second, graph.slot[2*l+1]);
+        }
 
+        void clear(int l)
+        {
+            clearEntry(links[l].first, graph.slot[2*l]);
+            clearEntry(links[l].second, graph.slot[2*l+1]);
+        }
 
-int main( int argc, char ** argv)
+        //true if node u has any link in the set
+        bool any(int u) const
+        {
+            for (int w = graph.maskOffset[u]; w < graph.maskOffset[u+1]; w++)
+                if(words[w])
+                    return true;
+            return false;
+        }
+
+    private:
+        void setEntry(int u, int e)
+        {
+            int bit = e - graph.offset[u];
+            words[graph.maskOffset[u] + bit / 64] |= (uint64_t)1 << (bit % 64);
+        }
+
+        void clearEntry(int u, int e)
+        {
+            int bit = e - graph.offset[u];
+            words[graph.maskOffset[u] + bit / 64] &= ~((uint64_t)1 << (bit % 64));
+        }
+};
+
+//node id of a name; -1 if the topology has no such node
+int findNode(const string &name)
 {
+    unordered_map<string,int>::const_iterator it = nodeIndex.find(name);
+    return (it == nodeIndex.end()) ? -1 : it->second;
+}
 
-//Load in the topology file
-    ifstream file;
-    file.open("topology.dat");
+//node at the other end of link l from node u
+inline int otherEnd(int l, int u)
+{
+    return (links[l].first == u) ? links[l].second : links[l].first;
+}
 
-    //load in topology
-    if(file.is_open() )
-    {
-        char a,b;
-        int c,d;
+//workload source: the in-memory eventQueue, or the workload file streamed one call at a time
+vector<string> workloadPaths(1, "callworkload.dat");  //several are merged by arrival time
+bool streaming = false;
+string policyName;              //run only this policy (empty: run all)
+int kPaths = 0;                 //candidate paths per pair for fixed-cost policies (0: always search)
+int threadCount = 0;            //worker threads for runs (0: one per hardware thread)
 
-        //while !EOF
-        while(file >> a >> b >> c >> d)
-        {
-            int src = a - 65;
-            int dest = b - 65;
 
-            //create seperate arrays with index representing Node Letter
-            propDelay[src][dest] = propDelay[dest][src] = c;
-            capacity[src][dest] = capacity[dest][src] = d;
-            availCap[src][dest] = availCap[dest][src] = d;
 
-        }      
 
-    }
-    else
+//shortest path from source to destination on the empty network under a fixed link cost, avoiding banned
+//links and nodes. Fills path with the link ids from source to destination; returns its cost (-1 if none)
+template <class Cost>
+double staticPath(int source, int destination, const Cost &linkCost, const vector<char> &bannedLink,
+                  const vector<char> &bannedNode, vector<int> &path)
+{
+    int nodes = nodeNames.size();
+    vector<double> dist(nodes, -1);
+    vector<int> previousLink(nodes, -1);
+    vector<char> visited(nodes, 0);
+    priority_queue< pair<double,int>, vector< pair<double,int> >, greater< pair<double,int> > > heap;
+
+    dist[source] = 0;
+    heap.push( make_pair(0.0, source) );
+    while(!heap.empty())
     {
-        cout << "error" << endl;
+        int u = heap.top().second;
+        heap.pop();
+        if(visited[u])
+            continue;
+        visited[u] = true;
+        if(u == destination)
+            break;
+
+        for (int e = graph.offset[u]; e < graph.offset[u+1]; e++)
+        {
+            int j = graph.neighbour[e];
+            int l = graph.link[e];
+            if(visited[j] || bannedLink[l] || bannedNode[j] || capacity[l] <= 0)
+                continue;
+
+            double alt = dist[u] + linkCost(l);
+            if(dist[j] < 0 || alt < dist[j])
+            {
+                dist[j] = alt;
+                previousLink[j] = l;
+                heap.push( make_pair(alt, j) );
+            }
+        }
     }
-    
 
-//Load in the Calls file
-    ifstream file2;
-    file2.open("callworkload.dat");
+    path.clear();
+    if(!visited[destination])
+        return -1;
+
+    //walk back from the destination, then put the links in source-to-destination order
+    for (int curr = destination; curr != source; curr = otherEnd(previousLink[curr], curr))
+        path.push_back(previousLink[curr]);
+    reverse(path.begin(), path.end());
+    return dist[destination];
+}
+
+
 
-    //load in calls
-    if(file2.is_open() )
+
+//up to k loopless paths from source to destination on the empty network, cheapest first (Yen's algorithm)
+template <class Cost>
+vector< vector<int> > kShortestPaths(int source, int destination, int k, const Cost &linkCost)
+{
+    vector< vector<int> > found;                    //A: accepted paths, in cost order
+    vector< pair< double, vector<int> > > pending;  //B: candidate paths not yet accepted
+    vector<char> bannedLink(links.size(), 0);
+    vector<char> bannedNode(nodeNames.size(), 0);
+    vector<int> path;
+
+    if(source < 0 || destination < 0 || source == destination)
+        return found;
+    if(staticPath(source, destination, linkCost, bannedLink, bannedNode, path) < 0)
+        return found;
+    found.push_back(path);
+
+    while(found.size() < k)
     {
-        char b,c;
-        double a,d;
+        const vector<int> last = found.back();
 
-        //while !EOF
-        while(file2 >> a >> b >> c >> d)
+        //deviate from the last accepted path at each of its nodes in turn
+        int spurNode = source;
+        double rootCost = 0;
+        for (int i = 0; i < last.size(); i++)
         {
-            //increment # of calls in file
-            totalCalls++;
+            vector<int> root(last.begin(), last.begin() + i);
+
+            //ban the next link of every accepted path sharing this root, and the root's own nodes
+            for (int p = 0; p < found.size(); p++)
+            {
+                if(found[p].size() > i && equal(root.begin(), root.end(), found[p].begin()))
+                    bannedLink[found[p][i]] = 1;
+            }
+            for (int n = source, r = 0; r < i; n = otherEnd(root[r], n), r++)
+                bannedNode[n] = 1;
+
+            double spurCost = staticPath(spurNode, destination, linkCost, bannedLink, bannedNode, path);
+            if(spurCost >= 0)
+            {
+                root.insert(root.end(), path.begin(), path.end());
+                bool known = false;
+                for (int p = 0; p < pending.size() && !known; p++)
+                    known = (pending[p].second == root);
+                if(!known)
+                    pending.push_back( make_pair(rootCost + spurCost, root) );
+            }
+
+            fill(bannedLink.begin(), bannedLink.end(), 0);
+            fill(bannedNode.begin(), bannedNode.end(), 0);
+            rootCost += linkCost(last[i]);
+            spurNode = otherEnd(last[i], spurNode);
+        }
 
-            //add event to queue
-            int src = b - 65;
-            int dest = c - 65;
-            eventQueue.push_back( CallEvent(a,d,src,dest)  );
+        if(pending.empty())
+            break;
+
+        //accept the cheapest candidate; earlier candidates win ties
+        int best = 0;
+        for (int p = 1; p < pending.size(); p++)
+        {
+            if(pending[p].first < pending[best].first)
+                best = p;
         }
+        found.push_back(pending[best].second);
+        pending.erase(pending.begin() + best);
     }
 
+    return found;
+}
+
 
 
-///print titles
-    printInit();        
 
+//k-shortest candidate paths per (source, destination) pair for a policy with fixed link costs.
+//Filled for the pairs of the loaded workload when a run starts, and on first use for any other pair
+class RouteCache
+{
+    public:
+        //candidate paths of a pair, cheapest first
+        template <class Cost>
+        const vector< vector<int> > &candidates(int source, int destination, int k, const Cost &linkCost)
+        {
+            long long key = (long long)source * nodeNames.size() + destination;
+            unordered_map< long long, vector< vector<int> > >::iterator it = routes.find(key);
+            if(it == routes.end())
+                it = routes.insert( make_pair(key, kShortestPaths(source, destination, k, linkCost)) ).first;
+            return it->second;
+        }
 
+    private:
+        unordered_map< long long, vector< vector<int> > > routes;
+};
 
 
-///////Run the algorithms////////////////////////////////////////////////////
 
 
+//synthetic workload settings; generation replaces the workload file when generateCalls > 0
+class GeneratorConfig
+{
+    public:
+        long generateCalls = 0;         //calls per replication
+        double arrivalRate = 1;         //Poisson arrivals per minute
+        double meanHolding = 10;        //mean holding time in minutes
+        double paretoShape = 0;         //> 1: Pareto holding times with this shape; otherwise exponential
+        uint64_t seed = 1;
+
+        //traffic matrix: weighted (source, destination) pairs. Empty means uniform over all pairs
+        vector< pair<int,int> > pairs;
+        vector<double> weights;
+};
+GeneratorConfig genConfig;
+
 
 
 
-//SDPF
-    //event tracker
-    int i= 0;
+//streams Poisson call arrivals between traffic matrix pairs, one call at a time. Each replication
+//draws from its own seed, and every policy in a replication sees the same calls
+class CallGenerator
+{
+    public:
+        CallGenerator(int replication)
+        {
+            seed_seq seq{ (uint64_t)genConfig.seed, (uint64_t)replication };
+            rng.seed(seq);
+            if(!genConfig.pairs.empty())
+                pickPair = discrete_distribution<int>(genConfig.weights.begin(), genConfig.weights.end());
+        }
+
+        //next call; false once generateCalls have been made
+        bool next(CallEvent &call)
+        {
+            if(made >= genConfig.generateCalls)
+                return false;
+            made++;
 
-    //current event attributes
-    int src;
-    int dst;
-    double start;
-    double end;
+            //exponential interarrival times
+            now += exponential_distribution<double>(genConfig.arrivalRate)(rng);
 
+            //holding time: exponential, or Pareto with the same mean
+            double holding;
+            if(genConfig.paretoShape > 1)
+            {
+                double a = genConfig.paretoShape;
+                double scale = genConfig.meanHolding * (a - 1) / a;
+                holding = scale / pow(1 - uniform_real_distribution<double>(0, 1)(rng), 1 / a);
+            }
+            else
+                holding = exponential_distribution<double>(1 / genConfig.meanHolding)(rng);
 
-    while(1)
-    {
-                while(1)
-                    {
-                                //load in event
-                                if(i < eventQueue.size() )
-                                {
-                                    
-                                    //handle time related event updates
-                                    timeUpdate(i);
-                                    
-                                    
-                                    //load in current event
-                                    src = eventQueue.at(i).source;
-                                    dst = eventQueue.at(i).destination;
-                                    start = eventQueue.at(i).startTime;
-                                    end = eventQueue.at(i).endTime;
-                                    eventQueue.at(i).running = true;
+            int src, dst;
+            if(!genConfig.pairs.empty())
+            {
+                const pair<int,int> &od = genConfig.pairs[pickPair(rng)];
+                src = od.first;
+                dst = od.second;
+            }
+            else
+            {
+                //uniform over ordered pairs of distinct nodes
+                int nodes = nodeNames.size();
+                src = uniform_int_distribution<int>(0, nodes - 1)(rng);
+                dst = uniform_int_distribution<int>(0, nodes - 2)(rng);
+                if(dst >= src)
+                    dst++;
+            }
 
-                                    //update edge costs
-                                    updateSHPF();
-                                }
-                                else
-                                {
-                                    //All events processed, print and exit
-                                    break;
-                                }
-                                
+            call = CallEvent(now, holding, src, dst);
+            return true;
+        }
 
+        //where the generator is in its stream: engine state as text, clock, and calls made. Kept in checkpoints
+        void save(string &engine, double &clock, long &calls) const
+        {
+            ostringstream out;
+            out << rng;
+            engine = out.str();
+            clock = now;
+            calls = made;
+        }
 
+        bool restore(const string &engine, double clock, long calls)
+        {
+            istringstream in(engine);
+            in >> rng;
+            now = clock;
+            made = calls;
+            return !in.fail();
+        }
 
-                                //run djikstra's algorithm on current event to determine reachability and update statistics as such
-                                if((updateState(src, dst, cost, i) == false) )
-                                {
-                                    
-                                    //no path available
-                                    blockedCalls++;
+    private:
+        mt19937_64 rng;
+        discrete_distribution<int> pickPair;
+        double now = 0;
+        long made = 0;
+};
 
-                                    //set event to finished
-                                    eventQueue.at(i).running = false;
-                                }
-                                else
-                                {
-                                    //path available
-                                    succCalls++;
-                                }
 
-                                //next event
-                                i++;
-                    }//end while
 
-                    //calculate and print statistics
-                    avgProp = totalProp/succCalls;
-                    avgHop = totalHops/succCalls;
-                    succPercent = succCalls/totalCalls *100;
-                    blockedPercent = blockedCalls/totalCalls *100;
-                    printRes("SHPF");
-                    clearValues();
-                    break;
-    }
 
+//load a traffic matrix: one "source destination weight" per line. Topology must be loaded
+bool loadTrafficMatrix(const string &path)
+{
+    LineReader in;
+    if(!in.open(path))
+        return false;
 
+    const char *begin, *end;
+    string key;
+    while(in.next(begin, end))
+    {
+        if(blankLine(begin, end))
+            continue;
+
+        const char *fieldBegin[3], *fieldEnd[3];
+        double w;
+        if(!splitFields(begin, end, 3, fieldBegin, fieldEnd) || !parseNumber(fieldBegin[2], fieldEnd[2], w) || w < 0)
+            inputError(in, "expected 'source destination weight'");
+
+        key.assign(fieldBegin[0], fieldEnd[0]);
+        int src = findNode(key);
+        key.assign(fieldBegin[1], fieldEnd[1]);
+        int dst = findNode(key);
+        if(src < 0 || dst < 0)
+            inputError(in, "node is not in the topology");
+
+        genConfig.pairs.push_back( make_pair(src, dst) );
+        genConfig.weights.push_back(w);
+    }
+    return true;
+}
 
 
 
 
+//connected components of the network formed by the links with free circuits, as a union-find forest.
+//Links regaining a circuit are joined in place; links saturating only mark the forest stale, since
+//union-find cannot split. A stale forest may join too much but never too little, so "not connected"
+//is always exact and proves a call blocked without searching.
+class Connectivity
+{
+    public:
+        vector<int> parent;
+        bool stale = false;     //links have saturated since the last rebuild
 
+        //recompute the components from scratch over the links with availCap > 0
+        void rebuild(const vector<int> &availCap)
+        {
+            parent.resize(nodeNames.size());
+            for (int u = 0; u < parent.size(); u++)
+                parent[u] = u;
+            for (int l = 0; l < availCap.size(); l++)
+                if(availCap[l] > 0)
+                    join(links[l].first, links[l].second);
+            stale = false;
+        }
 
-//SDPF
-    //event tracker
-    i= 0;
+        int find(int u)
+        {
+            //path halving
+            while(parent[u] != u)
+            {
+                parent[u] = parent[parent[u]];
+                u = parent[u];
+            }
+            return u;
+        }
 
-    //current event attributes
-    src = 0;
-    dst = 0;
-    start = 0;
-    end = 0;
+        void join(int a, int b)
+        {
+            a = find(a);
+            b = find(b);
+            if(a != b)
+                parent[max(a, b)] = min(a, b);
+        }
 
+        bool connected(int a, int b)
+        {
+            return find(a) == find(b);
+        }
+};
 
 
-    while(1)
-    {
-                while(1)
-                    {
-                                //load in event
-                                if(i < eventQueue.size() )
-                                {
-                                    
-                                    //handle time related event updates
-                                    timeUpdate(i);
-                                    
-                                    
-                                    //load in current event
-                                    src = eventQueue.at(i).source;
-                                    dst = eventQueue.at(i).destination;
-                                    start = eventQueue.at(i).startTime;
-                                    end = eventQueue.at(i).endTime;
-                                    eventQueue.at(i).running = true;
-
-                                }
-                                else
-                                {
-                                    //All events processed, print and exit
-                                    break;
-                                }
-                                
-
-
-
-                                //run djikstra's algorithm on current event to determine reachability and update statistics as such
-                                if((updateState(src, dst, propDelay, i) == false) )
-                                {
-                                    
-                                    //no path available
-                                    blockedCalls++;
-
-                                    //set event to finished
-                                    eventQueue.at(i).running = false;
-                                }
-                                else
-                                {
-                                    //path available
-                                    succCalls++;
-                                }
-
-                                //next event
-                                i++;
-                    }//end while
-
-                    //calculate and print statistics
-                    avgProp = totalProp/succCalls;
-                    avgHop = totalHops/succCalls;
-                    succPercent = succCalls/totalCalls *100;
-                    blockedPercent = blockedCalls/totalCalls *100;
-                    printRes("SDPF");
-                    clearValues();
-                    break;
-    }
-            
 
 
+const int INF_DIST = INT_MAX;   //hop count infinity
+const float INF_COST = HUGE_VALF;   //path cost infinity
 
+//state of the route searches of a run, reused by each. Every vertex carries the generation (search) it was
+//last reached and settled in; entries from older generations read as unreached, so starting a search
+//is O(1) and a search touches only the vertices it reaches, instead of resetting arrays of every node
+class SearchWorkspace
+{
+    public:
+        class Vertex
+        {
+            public:
+                double width = -1;          //widestPath(): widest bottleneck found so far
+                float dist = INF_COST;      //shortestPath(): lowest path cost found so far
+                int hops = INF_DIST;        //widestPath(): hops of that path
+                int previousLink = -1;      //link it was reached over, -1 for none
+                uint32_t reached = 0;       //generation these fields belong to
+                uint32_t settled = 0;       //generation it was settled in
+                uint32_t layered = 0;       //generation fewestHopsAtWidth() reached it in
+        };
+
+        vector<Vertex> vertex;                          //(index- the vertex)
+        uint32_t generation = 0;
+        vector< pair<float,int> > heap;                 //shortestPath()'s heap storage
+        vector< tuple<double,int,int> > wideHeap;       //widestPath()'s
+        vector<int> layer, nextLayer;                   //fewestHopsAtWidth()'s frontiers
+
+        //start a new search: every vertex becomes unreached
+        void begin()
+        {
+            if(vertex.size() != nodeNames.size())
+            {
+                vertex.assign(nodeNames.size(), Vertex());
+                generation = 0;
+            }
 
+            //on wrapping, clear the stamps so no stale one matches
+            if(++generation == 0)
+            {
+                for (int u = 0; u < vertex.size(); u++)
+                    vertex[u].reached = vertex[u].settled = vertex[u].layered = 0;
+                generation = 1;
+            }
+        }
 
+        //the entries of u, reset to unreached unless u was already reached in this search
+        Vertex &reach(int u)
+        {
+            Vertex &v = vertex[u];
+            if(v.reached != generation)
+            {
+                v = Vertex();
+                v.reached = generation;
+            }
+            return v;
+        }
 
+        bool settled(int u) const
+        {
+            return vertex[u].settled == generation;
+        }
 
+        //link u was reached over in this search, -1 for the source or a vertex not reached
+        int previous(int u) const
+        {
+            return (vertex[u].reached == generation) ? vertex[u].previousLink : -1;
+        }
+};
 
 
-//LLP
-        //event tracker
-    i= 0;
 
-    //current event attributes
-    src = 0;
-    dst = 0;
-    start = 0;
-    end = 0;
 
+//hop counts of the shortest paths of the empty network, for SHPO admission. A run computes the row of a
+//source the first time a call from it arrives, with a breadth first search over the links with capacity.
+//Rows are kept up to ROW_BUDGET counts in all, then dropped together, so memory stays bounded when a large
+//topology has more sources than that
+class EmptyHops
+{
+    public:
+        static const size_t ROW_BUDGET = 1 << 24;
 
+        //hops from source to destination, INF_DIST if unreachable
+        int hops(int source, int destination)
+        {
+            unordered_map< int, vector<int> >::iterator it = rows.find(source);
+            if(it == rows.end())
+            {
+                int nodes = nodeNames.size();
+                if(kept + nodes > ROW_BUDGET)
+                {
+                    rows.clear();
+                    kept = 0;
+                }
+                it = rows.emplace(source, vector<int>(nodes, INF_DIST)).first;
+                kept += nodes;
+                fill(source, it->second);
+            }
+            return it->second[destination];
+        }
 
-    while(1)
-    {
-                while(1)
+    private:
+        //visit the nodes in order of hop distance from source
+        void fill(int source, vector<int> &hops)
+        {
+            hops[source] = 0;
+            frontier.assign(1, source);
+            for (int f = 0; f < frontier.size(); f++)
+            {
+                int u = frontier[f];
+                for (int e = graph.offset[u]; e < graph.offset[u+1]; e++)
+                {
+                    int j = graph.neighbour[e];
+                    if(capacity[graph.link[e]] > 0 && hops[j] == INF_DIST)
                     {
-                                //load in event
-                                if(i < eventQueue.size() )
-                                {
-                                    
-                                    //handle time related event updates
-                                    timeUpdate(i);
-                                    
-                                    
-                                    //load in current event
-                                    src = eventQueue.at(i).source;
-                                    dst = eventQueue.at(i).destination;
-                                    start = eventQueue.at(i).startTime;
-                                    end = eventQueue.at(i).endTime;
-                                    eventQueue.at(i).running = true;
+                        hops[j] = hops[u] + 1;
+                        frontier.push_back(j);
+                    }
+                }
+            }
+        }
 
-                                    //update edge costs
-                                    updateLLP();
-                                }
-                                else
-                                {
-                                    //All events processed, print and exit
-                                    break;
-                                }
-                                
+        unordered_map< int, vector<int> > rows;     //(key- source; elem- hops to each node)
+        size_t kept = 0;                            //counts in rows
+        vector<int> frontier;
+};
 
 
 
-                                //run djikstra's algorithm on current event to determine reachability and update statistics as such
-                                if((updateState(src, dst, cost, i) == false) )
-                                {
-                                    
-                                    //no path available
-                                    blockedCalls++;
 
-                                    //set event to finished
-                                    eventQueue.at(i).running = false;
-                                }
-                                else
-                                {
-                                    //path available
-                                    succCalls++;
-                                }
+//work counters of a run. COUNT(statement) runs the statement only when compiled with -DROUTING_COUNTERS,
+//and is empty otherwise, so the counted hot paths cost nothing in normal builds
+#ifdef ROUTING_COUNTERS
+#define COUNT(statement) statement
+#else
+#define COUNT(statement)
+#endif
 
-                                //next event
-                                i++;
-                    }//end while
+class Counters
+{
+    public:
+        static const int BUCKETS = 16;
+
+        long searches = 0;
+        long pops = 0;                  //heap pops of all searches
+        long relaxations = 0;           //links relaxed by all searches
+        long fastBlocks = 0;            //calls blocked by Connectivity without a search
+        long reclaims = 0;              //timeUpdate() calls
+        long departed = 0;              //calls reclaimed by them
+        long departHistogram[BUCKETS] = {};     //timeUpdate() calls by calls reclaimed (see bucket())
+        size_t peakActive = 0;          //most calls in progress at once
+        vector<int> leastFree;          //fewest free circuits seen on each link
+
+        //histogram bucket of n: 0 for 0, then b for 2^(b-1) .. 2^b - 1, the last bucket open ended
+        static int bucket(long n)
+        {
+            int b = 0;
+            for (; n > 0 && b < BUCKETS - 1; n >>= 1)
+                b++;
+            return b;
+        }
+};
 
-                    //calculate and print statistics
-                    avgProp = totalProp/succCalls;
-                    avgHop = totalHops/succCalls;
-                    succPercent = succCalls/totalCalls *100;
-                    blockedPercent = blockedCalls/totalCalls *100;
-                    printRes("LLP");
-                    clearValues();
-                    break;
-    }
 
 
 
+//lanes of the dense engine, as GCC/Clang vector extensions: compiled to SSE2 by default, AVX2 with
+//-mavx2, NEON on ARM. Dense rows are padded to whole IntLanes, INT_LANES nodes each
+typedef int32_t IntLanes __attribute__((vector_size(32)));
+typedef float FloatLanes __attribute__((vector_size(32)));
+typedef int32_t HalfIntLanes __attribute__((vector_size(16)));
+typedef int64_t LongLanes __attribute__((vector_size(32)));
+typedef double DoubleLanes __attribute__((vector_size(32)));
+const int INT_LANES = 8;
+const int DOUBLE_LANES = 4;
 
+//dense engine: the network as node-by-node matrices, searched with a vectorized O(V^2) djikstra.
+//Fastest on small dense topologies; see chooseEngine()
+bool denseEngine = false;
+int denseStride = 0;                //row length: nodes rounded up to INT_LANES
+const int FIXED_BLOCKS = 8;         //largest fixed-size dense search, in IntLanes of nodes
+vector<IntLanes> denseLinkId;       //link between each pair of nodes, -1 if none. Read-only once built
 
+//fill denseLinkId from the links table
+void buildDenseLinks()
+{
+    int nodes = nodeNames.size();
+    denseStride = (nodes + INT_LANES - 1) / INT_LANES * INT_LANES;
+    denseLinkId.assign((size_t)denseStride * denseStride / INT_LANES, IntLanes{} - 1);
+    int32_t *id = (int32_t *)denseLinkId.data();
+    for (int l = 0; l < links.size(); l++)
+    {
+        id[(size_t)links[l].first * denseStride + links[l].second] = l;
+        id[(size_t)links[l].second * denseStride + links[l].first] = l;
+    }
+}
 
+//the dense engine pays off only with full-width vector units; on plain SSE2 its blends and conversions
+//are emulated and it is slower than the sparse engine
+#if defined(__AVX2__) || defined(__ARM_NEON)
+const bool WIDE_LANES = true;
+#else
+const bool WIDE_LANES = false;
+#endif
+
+//pick the engine for the loaded topology: "sparse", "dense", or "auto" for dense on small topologies with
+//at least a fifth of all node pairs linked, where a row scan beats chasing adjacency lists
+void chooseEngine(const string &engine)
+{
+    double nodes = nodeNames.size();
+    double pairs = nodes * (nodes - 1) / 2;
+    denseEngine = (engine == "dense")
+               || (engine == "auto" && WIDE_LANES && nodes <= 512 && links.size() >= 0.2 * pairs);
+    if(denseEngine)
+        buildDenseLinks();
+}
 
-//MFC
+//the per-run matrices and search scratch of the dense engine
+class DenseNetwork
+{
+    public:
+        bool active = false;
+        vector<IntLanes> freeCircuits;  //availCap of the link between each pair, 0 if none
+        vector<FloatLanes> cost;        //additive policies: weight of each link
+        vector<DoubleLanes> divisor;    //bottleneck policies: availCap / divisor is the width of each link
+
+        //search scratch, one row each
+        vector<FloatLanes> dist;
+        vector<IntLanes> visited, previous;
+        vector<DoubleLanes> width;
+        vector<LongLanes> wideVisited, wideHops, widePrevious;
+
+        void setFree(int l, int free)
+        {
+            int32_t *f = (int32_t *)freeCircuits.data();
+            f[(size_t)links[l].first * denseStride + links[l].second] = free;
+            f[(size_t)links[l].second * denseStride + links[l].first] = free;
+        }
+};
 
-    //event tracker
-    i= 0;
 
-    //current event attributes
-    src = 0;
-    dst = 0;
-    start = 0;
-    end = 0;
 
 
-    while(1)
-    {
-                while(1)
-                    {
-                                //load in event
-                                if(i < eventQueue.size() )
-                                {
-                                    
-                                    //handle time related event updates
-                                    timeUpdate(i);
-                                    
-                                    
-                                    //load in current event
-                                    src = eventQueue.at(i).source;
-                                    dst = eventQueue.at(i).destination;
-                                    start = eventQueue.at(i).startTime;
-                                    end = eventQueue.at(i).endTime;
-                                    eventQueue.at(i).running = true;
+//time-windowed statistics: every windowWidth minutes of simulated time each run appends one row to windowOut
+double windowWidth = 0;         //0: off
+FILE *windowOut = NULL;
+mutex windowLock;               //runs on several threads share windowOut
 
-                                    //update edge costs
-                                    updateMFC();
-                                }
-                                else
-                                {
-                                    //All events processed, print and exit
-                                    break;
-                                }
-                                
+//the window a run is in: its start, the run totals when it opened, and the integral of calls in progress
+class WindowStats
+{
+    public:
+        double start = 0;
+        double clock = 0;           //time busyTime is integrated up to
+        double busyTime = 0;        //call-minutes carried in the window
+        double calls = 0, blocked = 0, succ = 0, hops = 0, prop = 0;    //run totals at start
+};
 
 
 
-                                //run djikstra's algorithm on current event to determine reachability and update statistics as such
-                                if((updateState(src, dst, cost, i) == false) )
-                                {
-                                    
-                                    //no path available
-                                    blockedCalls++;
 
-                                    //set event to finished
-                                    eventQueue.at(i).running = false;
-                                }
-                                else
-                                {
-                                    //path available
-                                    succCalls++;
-                                }
+//a variation of the loaded network and workload to simulate. Scenarios with unscaled capacity share the
+//topology's capacity array; only scaled ones own a copy
+class Scenario
+{
+    public:
+        double capacityScale = 1;       //link capacities are multiplied by this
+        double loadScale = 1;           //arrival rate is multiplied by this (holding times are unchanged)
+        shared_ptr< const vector<int> > linkCapacity;
 
-                                //next event
-                                i++;
-                    }//end while
+        //topology must be loaded
+        Scenario(double capScale = 1, double arrivalScale = 1)
+        {
+            capacityScale = capScale;
+            loadScale = arrivalScale;
+            if(capScale == 1)
+            {
+                //point at the topology's own array without owning it
+                linkCapacity = shared_ptr< const vector<int> >(&capacity, [](const vector<int> *) {});
+                return;
+            }
 
-                    //calculate and print statistics
-                    avgProp = totalProp/succCalls;
-                    avgHop = totalHops/succCalls;
-                    succPercent = succCalls/totalCalls *100;
-                    blockedPercent = blockedCalls/totalCalls *100;
-                    printRes("MFC");
-                    clearValues();
-                    break;
-    }
+            //scaled links keep at least one circuit, so the topology itself never changes
+            vector<int> *scaled = new vector<int>(capacity);
+            for (int l = 0; l < scaled->size(); l++)
+            {
+                if((*scaled)[l] > 0)
+                    (*scaled)[l] = max(1L, lround((*scaled)[l] * capScale));
+            }
+            linkCapacity.reset(scaled);
+        }
+};
 
 
 
 
+//network state and statistics of one policy run. Runs share nothing else, so each can go on its own thread
+class SimState
+{
+    public:
+        Scenario scenario;
+        const vector<int> &linkCapacity;  //total capacity on each link in this run
+        vector<int> availCap;           //available capacity on each link
+        LinkMask freeLinks;             //links with availCap > 0, kept in step with availCap
+        Connectivity components;        //components over the same links, for blocking calls without a search
+        Counters counters;              //only counted with -DROUTING_COUNTERS
+        DenseNetwork dense;             //matrices of the dense engine, when in use
+        WindowStats window;             //only kept with windowWidth > 0
+        const char *policy = "";        //name of the policy run, for window rows
+        int replication;
+
+        //running calls, and their pending departures as a min-heap keyed by end time
+        CallPool calls;
+        priority_queue< Departure, vector<Departure>, greater<Departure> > departures;
+        SearchWorkspace search;         //route search state, reused by every call
+        EmptyHops emptyHops;            //SHPO admission limits, computed as calls need them
+        int lastAdmitted = -1;          //pool slot of the call admitted last
+
+        ArrivalMerge streamReader;      //this runs own pass over the workload in streaming mode
+        int firstCall = 0;              //call the run starts at: 0, or where the snapshot it resumes left off
+        vector<StreamPosition> resumeAt;        //where that snapshot left the streamed workload
+        RouteCache routes;              //candidate paths when kPaths > 0
+        unique_ptr<CallGenerator> generator;    //synthetic calls, when generating
+
+        //statistics
+        double blockedCalls = 0;
+        double succCalls = 0;
+        double totalSuccCalls = 0;
+        double totalCalls = 0;
+        double totalHops = 0;
+        double totalProp = 0;
+
+        double blockedPercent = 0;
+        double succPercent = 0;
+        double avgHop = 0;
+        double avgProp = 0;
+
+        //benchmark timings, recorded only when timing is set
+        bool timing = false;
+        vector<float> routeNanos;       //time to route each call
+        double reclaimNanos = 0;        //total time reclaiming the circuits of departed calls
+
+        //start from an empty network; topology and workload must be loaded
+        SimState(const Scenario &sc = Scenario(), int rep = 0) : scenario(sc), linkCapacity(*sc.linkCapacity), replication(rep)
+        {
+            availCap = linkCapacity;
+            freeLinks.reset();
+            for (int l = 0; l < availCap.size(); l++)
+                if(availCap[l] > 0)
+                    freeLinks.set(l);
+            components.rebuild(availCap);
+            COUNT(counters.leastFree = availCap);
+            totalCalls = eventQueue.size();
+            if(genConfig.generateCalls > 0)
+                generator.reset(new CallGenerator(rep));
+        }
+};
 
 
-//SHPO
 
-    //event tracker
-    i= 0;
 
-    //current event attributes
-    src = 0;
-    dst = 0;
-    start = 0;
-    end = 0;
 
 
-    while(1)
-    {
-                while(1)
-                    {
-                                //load in event
-                                if(i < eventQueue.size() )
-                                {
-                                    
-                                    //handle time related event updates
-                                    timeUpdate(i);
-                                    
-                                    
-                                    //load in current event
-                                    src = eventQueue.at(i).source;
-                                    dst = eventQueue.at(i).destination;
-                                    start = eventQueue.at(i).startTime;
-                                    end = eventQueue.at(i).endTime;
-                                    eventQueue.at(i).running = true;
-
-                                    //update edge costs
-                                    updateSHPF();
-                                }
-                                else
-                                {
-                                    //All events processed, print and exit
-                                    break;
-                                }
-                                
-
-
-
-                                //run djikstra's algorithm on current event to determine unreachability , or if hop2 > hopEmpty. block calls on both
-                                if( emptySHPO(src, dst, cost, availCap , i) > emptySHPO(src, dst, cost, capacity , i)    )
-                                {
-                 
-                                    //no path available
-                                    blockedCalls++;
-
-                                    //set event to finished
-                                    eventQueue.at(i).running = false;
-                                }
-                                else
-                                {
-                                    //update stats with hop2 results
-                                    updateState(src, dst, cost, i);
-
-                                    //path available
-                                    succCalls++;
-                                }
-
-                                //next event
-                                i++;
-                    }//end while
-
-                    //calculate and print statistics
-                    avgProp = totalProp/succCalls;
-                    avgHop = totalHops/succCalls;
-                    succPercent = succCalls/totalCalls *100;
-                    blockedPercent = blockedCalls/totalCalls *100;
-                    printRes("SHPO");
-                    clearValues();
-                    break;
-    }
-}//end mian
 
+//printer function for debugging; takes in a per-link array and prints its elements
+template <class T>
+void pr(const vector<T> &ar)
+{
+    for (int l = 0; l < links.size(); l++)
+        cout << nodeNames[links[l].first] << "-" << nodeNames[links[l].second] << "\t" << ar[l] << endl;
+}//end printer
 
+
+
+
+
+
+//print titles
+void printInit()
+{
+    printf("%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\n%-12s\n",
+        "Policy","Total Calls","Successful","Success(%)","Blocked", "Blocked(%)", "Avg Hops(ms)", "Avg Delay",
+        "=========================================================================================================================");
+}
+
+//print resulting stats
+void printRes(const char *s, const SimState &st)
+{
+    printf("%-12s\t%-12.0f\t%-12.0f\t%-12.2f\t%-12.0f\t%-12.2f\t%-12.4f\t%-12.4f\n",
+       s, st.totalCalls, st.succCalls, st.succPercent, st.blockedCalls, st.blockedPercent, st.avgHop, st.avgProp);
+
+}
+
+
+
+
+
+//print the work counters of a run to stderr (nothing unless compiled with -DROUTING_COUNTERS)
+void printCounters(const char *s, const SimState &st)
+{
+#ifdef ROUTING_COUNTERS
+    const Counters &c = st.counters;
+    fprintf(stderr, "%s counters:\n", s);
+    fprintf(stderr, "  searches %ld, fast blocks %ld, pops/search %.2f, relaxations/search %.2f\n", c.searches, c.fastBlocks,
+            c.searches ? (double)c.pops / c.searches : 0.0, c.searches ? (double)c.relaxations / c.searches : 0.0);
+    fprintf(stderr, "  reclaims %ld, departures/reclaim %.3f, peak active calls %zu\n", c.reclaims,
+            c.reclaims ? (double)c.departed / c.reclaims : 0.0, c.peakActive);
+
+    fprintf(stderr, "  departures per reclaim:");
+    for (int b = 0; b < Counters::BUCKETS; b++)
+    {
+        if(c.departHistogram[b] == 0)
+            continue;
+        if(b < 2)
+            fprintf(stderr, " [%d] %ld", b, c.departHistogram[b]);
+        else
+            fprintf(stderr, " [%ld-%ld] %ld", 1L << (b-1), (1L << b) - 1, c.departHistogram[b]);
+    }
+    fprintf(stderr, "\n");
+
+    //peak utilization of each link, busiest first
+    vector< pair<double,int> > peak;
+    for (int l = 0; l < c.leastFree.size(); l++)
+    {
+        if(st.linkCapacity[l] > 0)
+            peak.push_back( make_pair(1 - (double)c.leastFree[l] / st.linkCapacity[l], l) );
+    }
+    sort(peak.begin(), peak.end(), greater< pair<double,int> >());
+    int saturated = 0;
+    for (int k = 0; k < peak.size(); k++)
+        saturated += (peak[k].first >= 1);
+    fprintf(stderr, "  links saturated at some point %d of %zu; peak utilization:", saturated, peak.size());
+    for (int k = 0; k < peak.size() && k < 5; k++)
+    {
+        int l = peak[k].second;
+        fprintf(stderr, " %s-%s %.2f", nodeNames[links[l].first].c_str(), nodeNames[links[l].second].c_str(), peak[k].first);
+    }
+    fprintf(stderr, "\n");
+#else
+    (void)s;
+    (void)st;
+#endif
+}
+
+
+
+
+//fetch the i-th call of the workload in arrival order, as recorded; false once the workload is exhausted
+bool fetchCall(SimState &st, int i, CallEvent &call)
+{
+    //generated calls stream straight into the run
+    if(st.generator)
+    {
+        if(!st.generator->next(call))
+            return false;
+        st.totalCalls = i+1;
+        return true;
+    }
+
+    if(!streaming)
+    {
+        if(i >= eventQueue.size())
+            return false;
+        call = eventQueue.at(i);
+        return true;
+    }
+
+    //(re)start the stream at the beginning of each run, or where its snapshot left it
+    if(i == st.firstCall)
+    {
+        if(!st.streamReader.open(workloadPaths, st.resumeAt))
+        {
+            cerr << "error: cannot stream the workload" << (st.resumeAt.empty() ? "" : " from its snapshot position") << endl;
+            exit(1);
+        }
+        if(i == 0)
+            st.totalCalls = 0;
+    }
+
+    if(!st.streamReader.next(call))
+        return false;
+
+    st.totalCalls++;
+    return true;
+}
+
+
+
+
+//fetch the i-th call of the workload in arrival order, as seen by this runs scenario
+bool nextCall(SimState &st, int i, CallEvent &call)
+{
+    if(!fetchCall(st, i, call))
+        return false;
+
+    //compress (or stretch) arrival times for scenarios with scaled load
+    if(st.scenario.loadScale != 1)
+    {
+        double duration = call.endTime - call.startTime;
+        call.startTime /= st.scenario.loadScale;
+        call.endTime = call.startTime + duration;
+    }
+    return true;
+}
+
+
+
+
+//true if the policy should be run
+bool policySelected(const char *s)
+{
+    return policyName.empty() || policyName == s;
+}
+
+
+
+
+//write the row of the current window, ending at end, and open the next one
+void closeWindow(SimState &st, double end)
+{
+    WindowStats &w = st.window;
+    double calls = st.succCalls + st.blockedCalls - w.calls;
+    double blocked = st.blockedCalls - w.blocked;
+    double succ = st.succCalls - w.succ;
+    {
+        lock_guard<mutex> hold(windowLock);
+        fprintf(windowOut, "%s,%.4g,%.4g,%d,%.6f,%.6f,%.0f,%.0f,%.4f,%.4f,%.4f,%.4f\n", st.policy,
+                st.scenario.capacityScale, st.scenario.loadScale, st.replication, w.start, end, calls, blocked,
+                calls ? blocked / calls * 100 : 0.0, (end > w.start) ? w.busyTime / (end - w.start) : 0.0,
+                succ ? (st.totalHops - w.hops) / succ : 0.0, succ ? (st.totalProp - w.prop) / succ : 0.0);
+        fflush(windowOut);
+    }
+
+    w.start = end;
+    w.busyTime = 0;
+    w.calls = st.succCalls + st.blockedCalls;
+    w.blocked = st.blockedCalls;
+    w.succ = st.succCalls;
+    w.hops = st.totalHops;
+    w.prop = st.totalProp;
+}
+
+//move the window clock to time t, integrating the calls in progress and closing every window that ends by t
+void advanceWindow(SimState &st, double t)
+{
+    WindowStats &w = st.window;
+    double active = st.departures.size();
+    while(t >= w.start + windowWidth)
+    {
+        double end = w.start + windowWidth;
+        w.busyTime += active * (end - w.clock);
+        w.clock = end;
+        closeWindow(st, end);
+    }
+    w.busyTime += active * (t - w.clock);
+    w.clock = t;
+}
+
+void writeWindowHeader(FILE *out)
+{
+    fprintf(out, "policy,capacity_scale,load_scale,replication,window_start,window_end,calls,blocked,"
+                 "blocked_pct,carried_load,mean_hops,mean_delay\n");
+    fflush(out);
+}
+
+//open the window file of an interrupted run for the runs resuming it. Rows a resumed run wrote after its
+//snapshot (from the snapshot's window on, or all of them if it starts afresh) are dropped, as the run
+//writes them again; the rest are kept. Files that are not regular, or do not exist yet, start over
+FILE *resumeWindows(const string &path, const vector<const SimState *> &resumed)
+{
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        FILE *out = fopen(path.c_str(), "w");
+        if(out != NULL)
+            writeWindowHeader(out);
+        return out;
+    }
+
+    LineReader in;
+    if(!in.open(path))
+        return NULL;
+    string kept;
+    const char *begin, *end;
+    while(in.next(begin, end))
+    {
+        //policy,capacity_scale,load_scale,replication,window_start,..: where each of the first five fields ends
+        const char *fieldEnd[5];
+        const char *pos = begin;
+        int fields = 0;
+        while(fields < 5)
+        {
+            const char *comma = (const char *)memchr(pos, ',', end - pos);
+            fieldEnd[fields++] = (comma == NULL) ? end : comma;
+            if(comma == NULL)
+                break;
+            pos = comma + 1;
+        }
+        double start;
+        bool row = (fields == 5) && parseNumber(fieldEnd[3] + 1, fieldEnd[4], start);
+
+        bool drop = false;
+        for (int r = 0; row && r < resumed.size(); r++)
+        {
+            const char *policy = resumed[r]->policy;
+            if(fieldEnd[0] - begin == strlen(policy) && memcmp(begin, policy, strlen(policy)) == 0)
+                drop = (start >= resumed[r]->window.start - windowWidth / 2);
+        }
+        if(!drop)
+        {
+            kept.append(begin, end);
+            kept += '\n';
+        }
+    }
+    if(in.failed())
+        return NULL;
+
+    //write the kept rows beside the file and move them over it, so a crash now loses nothing
+    string tmpPath = path + ".tmp";
+    FILE *out = fopen(tmpPath.c_str(), "w");
+    if(out == NULL)
+        return NULL;
+    if(kept.empty())
+        writeWindowHeader(out);
+    fwrite(kept.data(), 1, kept.size(), out);
+    if(fflush(out) != 0 || ferror(out) || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        fclose(out);
+        unlink(tmpPath.c_str());
+        return NULL;
+    }
+    return out;
+}
+
+
+
+
+//give back one circuit of link l; a link gaining its first free circuit becomes usable again
+inline void returnCircuit(SimState &st, int l)
+{
+    if(st.availCap[l]++ == 0)
+    {
+        st.freeLinks.set(l);
+        st.components.join(links[l].first, links[l].second);
+    }
+    if(st.dense.active)
+        st.dense.setFree(l, st.availCap[l]);
+}
+
+//take one circuit of link l; a link losing its last one leaves the usable network
+inline void takeCircuit(SimState &st, int l)
+{
+    if(--st.availCap[l] == 0)
+    {
+        st.freeLinks.clear(l);
+        st.components.stale = true;
+    }
+    if(st.dense.active)
+        st.dense.setFree(l, st.availCap[l]);
+    COUNT(st.counters.leastFree[l] = min(st.counters.leastFree[l], st.availCap[l]));
+}
+
+//set the free circuits of link l to free, keeping freeLinks and components in step
+void setFreeCircuits(SimState &st, int l, int free)
+{
+    bool wasFree = (st.availCap[l] > 0);
+    st.availCap[l] = free;
+    if(!wasFree && free > 0)
+    {
+        st.freeLinks.set(l);
+        st.components.join(links[l].first, links[l].second);
+    }
+    else if(wasFree && free <= 0)
+    {
+        st.freeLinks.clear(l);
+        st.components.stale = true;
+    }
+    if(st.dense.active)
+        st.dense.setFree(l, free);
+}
+
+
+
+
+//recover resources for calls finished by time now
+void timeUpdate(SimState &st, double now)
+{
+    COUNT(long departed = 0);
+
+    //pop only the running calls whose end time <= now, earliest first
+    while(!st.departures.empty() && st.departures.top().endTime <= now)
+    {
+        COUNT(departed++);
+        if(windowWidth > 0)
+            advanceWindow(st, st.departures.top().endTime);
+
+        //reclaim that calls resources, and place them back in available capacity array
+        int slot = st.departures.top().slot;
+        const PathRecord &path = st.calls[slot].path;
+        for (int k = 0; k < path.size(); k++)
+            returnCircuit(st, path[k]);
+
+        //end call
+        st.calls.release(slot);
+        st.departures.pop();
+    }
+
+    if(windowWidth > 0)
+        advanceWindow(st, now);
+
+    COUNT(st.counters.reclaims++);
+    COUNT(st.counters.departed += departed);
+    COUNT(st.counters.departHistogram[Counters::bucket(departed)]++);
+}
+
+
+
+
+
+
+//Link costs and widths are not stored: the searches compute them on demand from the current availCap,
+//so only the links actually relaxed are costed and nothing is rebuilt per call.
+
+//cost of link l for SHPF algorithm
+inline float costSHPF(const SimState &st, int l)
+{
+    return (st.availCap[l] > 0) ? 1 : 0;
+}
+
+
+
+
+//width of link l for LLP algorithm: the fraction of its circuits free. The widest path is the one whose
+//busiest link has the lowest utilization
+inline double widthLLP(const SimState &st, int l)
+{
+    return (double)st.availCap[l] / (double)st.linkCapacity[l];
+}
+
+
+
+
+//width of link l for MFC algorithm: its number of free circuits
+inline double widthMFC(const SimState &st, int l)
+{
+    return st.availCap[l];
+}
+
+
+
+
+
+//call visit(j, l) for each neighbour j of u over a link l in usable: walks the set bits of u's words
+template <class Visit>
+inline void forEachUsable(int u, const LinkMask &usable, const Visit &visit)
+{
+    for (int w = graph.maskOffset[u]; w < graph.maskOffset[u+1]; w++)
+    {
+        for (uint64_t bits = usable.words[w]; bits; bits &= bits - 1)
+        {
+            int e = graph.offset[u] + (w - graph.maskOffset[u]) * 64 + __builtin_ctzll(bits);
+            visit(graph.neighbour[e], graph.link[e]);
+        }
+    }
+}
+
+
+
+
+//run djikstras algorithm on the adjacency lists between 2 points, following only the links in usable.
+//edgeCost(l) gives the weight of link l. If the source (or destination) has no usable link, it is cut
+//off from the network and the search is not run. The search stops as the destination settles, so it
+//touches only the vertices nearer than it; the path is left in ws (see SearchWorkspace::previous()).
+//returns true if the destination was reached
+template <class Cost>
+bool shortestPath(int source, int destination, const Cost &edgeCost, const LinkMask &usable,
+                  SearchWorkspace &ws, [[maybe_unused]] Counters &count)
+{
+    ws.begin();
+
+    //calls from or to nodes outside the topology cannot be routed
+    if(source < 0 || destination < 0)
+        return false;
+
+    //an endpoint with every link saturated cannot be reached
+    if(!usable.any(source) || (destination != source && !usable.any(destination)))
+        return false;
+
+    //min-heap of (distance, vertex); ties pop the lowest vertex first. Stale entries are skipped
+    vector< pair<float,int> > &heap = ws.heap;
+    greater< pair<float,int> > later;
+    heap.clear();
+
+    //set source vertex's distance as 0
+    ws.reach(source).dist = 0;
+    heap.push_back( make_pair(0, source) );
+
+    while(!heap.empty())
+    {
+        //vertex with the current minimum distance
+        int u = heap.front().second;
+        pop_heap(heap.begin(), heap.end(), later);
+        heap.pop_back();
+
+        SearchWorkspace::Vertex &vu = ws.vertex[u];
+        if(vu.settled == ws.generation)
+            continue;
+        vu.settled = ws.generation;
+        COUNT(count.pops++);
+
+        //stop searching if destination vertex found
+        if(u == destination)
+            return true;
+
+        //for the neighbours of u still unvisited, over usable links only
+        forEachUsable(u, usable, [&](int j, int l)
+        {
+            if(ws.settled(j))
+                return;
+
+            COUNT(count.relaxations++);
+
+            //determine distance to these neighbours from u
+            float alt = vu.dist + edgeCost(l);
+
+            //update distance of j from source, if its less than existing distance
+            SearchWorkspace::Vertex &vj = ws.reach(j);
+            if(alt < vj.dist)
+            {
+                vj.dist = alt;
+                vj.previousLink = l;    //j is now reached from u over link l
+                heap.push_back( make_pair(alt, j) );
+                push_heap(heap.begin(), heap.end(), later);
+            }
+        });
+    }
+
+    //no path found
+    return false;
+}
+
+
+
+
+template <class Width>
+void fewestHopsAtWidth(int source, int destination, const Width &linkWidth, const LinkMask &usable,
+                       SearchWorkspace &ws, [[maybe_unused]] Counters &count);
+
+//bottleneck search: find the path over links in usable whose narrowest link is widest, where linkWidth(l)
+//is the width of link l. Modified djikstra that settles vertices in order of (width desc, hops asc,
+//vertex asc) to find the widest bottleneck; fewestHopsAtWidth() then takes a path of fewest links among
+//all that wide. Widths are compared exactly; nothing is summed, so fractional widths keep their order.
+//The path is left in ws as by shortestPath(). returns true if the destination was reached
+template <class Width>
+bool widestPath(int source, int destination, const Width &linkWidth, const LinkMask &usable,
+                SearchWorkspace &ws, [[maybe_unused]] Counters &count)
+{
+    ws.begin();
+
+    if(source < 0 || destination < 0)
+        return false;
+    if(!usable.any(source) || (destination != source && !usable.any(destination)))
+        return false;
+
+    //min-heap of (-width, hops, vertex): the widest, then shortest, then lowest vertex pops first
+    typedef tuple<double,int,int> Entry;
+    vector<Entry> &heap = ws.wideHeap;
+    greater<Entry> later;
+    heap.clear();
+
+    SearchWorkspace::Vertex &start = ws.reach(source);
+    start.width = HUGE_VAL;
+    start.hops = 0;
+    heap.push_back( make_tuple(-HUGE_VAL, 0, source) );
+
+    while(!heap.empty())
+    {
+        int u = get<2>(heap.front());
+        pop_heap(heap.begin(), heap.end(), later);
+        heap.pop_back();
+
+        SearchWorkspace::Vertex &vu = ws.vertex[u];
+        if(vu.settled == ws.generation)
+            continue;
+        vu.settled = ws.generation;
+        COUNT(count.pops++);
+
+        //a path is never wider than any of its prefixes, so the first time the destination pops it is final
+        if(u == destination)
+        {
+            fewestHopsAtWidth(source, destination, linkWidth, usable, ws, count);
+            return true;
+        }
+
+        forEachUsable(u, usable, [&](int j, int l)
+        {
+            if(ws.settled(j))
+                return;
+
+            COUNT(count.relaxations++);
+            double w = min(vu.width, (double)linkWidth(l));
+            int h = vu.hops + 1;
+            SearchWorkspace::Vertex &vj = ws.reach(j);
+            if(w > vj.width || (w == vj.width && h < vj.hops))
+            {
+                vj.width = w;
+                vj.hops = h;
+                vj.previousLink = l;
+                heap.push_back( make_tuple(-w, h, j) );
+                push_heap(heap.begin(), heap.end(), later);
+            }
+        });
+    }
+
+    //no path found
+    return false;
+}
+
+
+
+
+
+//second phase of a bottleneck search that has left a path to destination in ws: take a path of fewest
+//links among all those no narrower than it. Breadth first over the links at least that wide, each layer in
+//vertex order, so every vertex is reached from the lowest vertex of the layer before it that links to it.
+//Both engines finish with this, so they settle ties alike. The path replaces the first one in ws
+template <class Width>
+void fewestHopsAtWidth(int source, int destination, const Width &linkWidth, const LinkMask &usable,
+                       SearchWorkspace &ws, [[maybe_unused]] Counters &count)
+{
+    if(source == destination)
+        return;
+
+    //bottleneck of the path found
+    double narrowest = HUGE_VAL;
+    for (int curr = destination; ws.previous(curr) > -1; curr = otherEnd(ws.previous(curr), curr))
+        narrowest = min(narrowest, (double)linkWidth(ws.previous(curr)));
+
+    vector<int> &layer = ws.layer;
+    vector<int> &nextLayer = ws.nextLayer;
+    layer.assign(1, source);
+    ws.reach(source).layered = ws.generation;
+    while(!layer.empty())
+    {
+        sort(layer.begin(), layer.end());
+        nextLayer.clear();
+        for (int k = 0; k < layer.size(); k++)
+        {
+            bool found = false;
+            forEachUsable(layer[k], usable, [&](int j, int l)
+            {
+                if(found || ws.vertex[j].layered == ws.generation)
+                    return;
+                COUNT(count.relaxations++);
+                if(linkWidth(l) < narrowest)
+                    return;
+
+                SearchWorkspace::Vertex &vj = ws.reach(j);
+                vj.layered = ws.generation;
+                vj.previousLink = l;
+                nextLayer.push_back(j);
+                found = (j == destination);
+            });
+            if(found)
+                return;
+        }
+        swap(layer, nextLayer);
+    }
+}
+
+
+
+
+
+//admit a routed call ending at endTime: a pool slot for the links it will hold, and its departure
+ActiveCall &admitCall(SimState &st, double endTime)
+{
+    int slot = st.calls.acquire();
+    st.lastAdmitted = slot;
+    st.departures.push( Departure(endTime, slot) );
+    return st.calls[slot];
+}
+
+
+
+
+//take one circuit of link l for a call being routed, and update statistics
+void holdLink(SimState &st, ActiveCall &call, int l)
+{
+    //decrease available circuits for current link
+    takeCircuit(st, l);
+
+    //update current events attained resources
+    call.path.push(l);
+
+    //update total propDelay
+    st.totalProp += propDelay[l];
+
+    //update total number of hops
+    st.totalHops++;
+}
+
+
+
+
+//horizontal minimum and maximum of lanes
+inline float minLane(FloatLanes v)
+{
+    float m = v[0];
+    for (int k = 1; k < INT_LANES; k++)
+        m = min(m, v[k]);
+    return m;
+}
+
+inline double maxLane(DoubleLanes v)
+{
+    double m = v[0];
+    for (int k = 1; k < DOUBLE_LANES; k++)
+        m = max(m, v[k]);
+    return m;
+}
+
+//lanes set in a comparison mask
+inline int setLanes(IntLanes mask)
+{
+    int n = 0;
+    for (int k = 0; k < INT_LANES; k++)
+        n += (mask[k] != 0);
+    return n;
+}
+
+inline int setLanes(LongLanes mask)
+{
+    int n = 0;
+    for (int k = 0; k < DOUBLE_LANES; k++)
+        n += (mask[k] != 0);
+    return n;
+}
+
+inline int64_t minLane(LongLanes v)
+{
+    int64_t m = v[0];
+    for (int k = 1; k < DOUBLE_LANES; k++)
+        m = min(m, v[k]);
+    return m;
+}
+
+
+
+
+//shortestPath() on the dense matrices: each step scans the unvisited distances for the lowest (ties to the
+//lowest vertex) and relaxes its whole row, a lane block at a time. Settles vertices in the same order
+//and relaxes with the same arithmetic as shortestPath(), so the paths found are the same.
+//BLOCKS > 0 fixes the row length at compile time (BLOCKS * INT_LANES nodes, see chooseDenseSearches()): the scratch
+//rows then live on the stack and the block loops unroll. BLOCKS = 0 handles any denseStride
+template <int BLOCKS>
+bool denseShortestPath(SimState &st, int source, int destination, SearchWorkspace &ws, [[maybe_unused]] Counters &count)
+{
+    int nodes = nodeNames.size();
+    ws.begin();
+    if(source < 0 || destination < 0)
+        return false;
+    if(!st.freeLinks.any(source) || (destination != source && !st.freeLinks.any(destination)))
+        return false;
+
+    DenseNetwork &d = st.dense;
+    const int blocks = BLOCKS ? BLOCKS : denseStride / INT_LANES;
+    FloatLanes fixedDist[BLOCKS ? BLOCKS : 1];
+    IntLanes fixedRows[2][BLOCKS ? BLOCKS : 1];
+    if(!BLOCKS)
+    {
+        d.dist.resize(blocks);
+        d.visited.resize(blocks);
+        d.previous.resize(blocks);
+    }
+    FloatLanes *distRow = BLOCKS ? fixedDist : d.dist.data();
+    IntLanes *visitedRow = BLOCKS ? fixedRows[0] : d.visited.data();
+    IntLanes *previousRow = BLOCKS ? fixedRows[1] : d.previous.data();
+    for (int b = 0; b < blocks; b++)
+    {
+        distRow[b] = FloatLanes{} + INF_COST;
+        visitedRow[b] = IntLanes{};
+        previousRow[b] = IntLanes{} - 1;
+    }
+    float *dist = (float *)distRow;
+    int32_t *visited = (int32_t *)visitedRow;
+    int32_t *previous = (int32_t *)previousRow;
+
+    //padding lanes are never picked
+    for (int n = nodes; n < denseStride; n++)
+        visited[n] = -1;
+    dist[source] = 0;
+
+    while(true)
+    {
+        //lowest distance among the unvisited vertices
+        FloatLanes best = FloatLanes{} + INF_COST;
+        for (int b = 0; b < blocks; b++)
+        {
+            FloatLanes key = visitedRow[b] ? FloatLanes{} + INF_COST : distRow[b];
+            best = (key < best) ? key : best;
+        }
+        float m = minLane(best);
+        if(m == INF_COST)
+            break;
+
+        int u = 0;
+        while(visited[u] || dist[u] != m)
+            u++;
+        visited[u] = -1;
+        COUNT(count.pops++);
+
+        if(u == destination)
+            break;
+
+        //relax u's row: alt = dist[u] + cost in float, as in shortestPath()
+        const IntLanes *freeRow = &d.freeCircuits[(size_t)u * blocks];
+        const FloatLanes *costRow = &d.cost[(size_t)u * blocks];
+        const IntLanes *linkRow = &denseLinkId[(size_t)u * blocks];
+        FloatLanes base = FloatLanes{} + dist[u];
+        for (int b = 0; b < blocks; b++)
+        {
+            FloatLanes alt = base + costRow[b];
+            COUNT(count.relaxations += setLanes((freeRow[b] > 0) & ~visitedRow[b]));
+            IntLanes better = (freeRow[b] > 0) & ~visitedRow[b] & (alt < distRow[b]);
+            distRow[b] = better ? alt : distRow[b];
+            previousRow[b] = (linkRow[b] & better) | (previousRow[b] & ~better);
+        }
+    }
+
+    if(!visited[destination])
+        return false;
+
+    //only the path is kept in ws
+    for (int curr = destination; previous[curr] > -1; curr = otherEnd(previous[curr], curr))
+        ws.reach(curr).previousLink = previous[curr];
+    ws.reach(source);
+    return true;
+}
+
+
+
+
+//widestPath() on the dense matrices: each step picks the unvisited vertex of widest bottleneck, then fewest
+//hops, then lowest id, and relaxes its whole row a lane block at a time. Widths are availCap / divisor in
+//double precision, as linkWidth() computes them, so the paths found are the same as widestPath()'s.
+//BLOCKS as for denseShortestPath(), in IntLanes of nodes
+template <int BLOCKS>
+bool denseWidestPath(SimState &st, int source, int destination, SearchWorkspace &ws, [[maybe_unused]] Counters &count)
+{
+    int nodes = nodeNames.size();
+    ws.begin();
+    if(source < 0 || destination < 0)
+        return false;
+    if(!st.freeLinks.any(source) || (destination != source && !st.freeLinks.any(destination)))
+        return false;
+
+    DenseNetwork &d = st.dense;
+    const int FIXED = BLOCKS * INT_LANES / DOUBLE_LANES;
+    const int blocks = FIXED ? FIXED : denseStride / DOUBLE_LANES;
+    DoubleLanes fixedWidth[FIXED ? FIXED : 1];
+    LongLanes fixedRows[3][FIXED ? FIXED : 1];
+    if(!FIXED)
+    {
+        d.width.resize(blocks);
+        d.wideVisited.resize(blocks);
+        d.wideHops.resize(blocks);
+        d.widePrevious.resize(blocks);
+    }
+    DoubleLanes *widthRow = FIXED ? fixedWidth : d.width.data();
+    LongLanes *visitedRow = FIXED ? fixedRows[0] : d.wideVisited.data();
+    LongLanes *hopsRow = FIXED ? fixedRows[1] : d.wideHops.data();
+    LongLanes *previousRow = FIXED ? fixedRows[2] : d.widePrevious.data();
+    for (int b = 0; b < blocks; b++)
+    {
+        widthRow[b] = DoubleLanes{} - 1;
+        visitedRow[b] = LongLanes{};
+        hopsRow[b] = LongLanes{} + INF_DIST;
+        previousRow[b] = LongLanes{} - 1;
+    }
+    double *width = (double *)widthRow;
+    int64_t *visited = (int64_t *)visitedRow;
+    int64_t *hops = (int64_t *)hopsRow;
+    int64_t *previous = (int64_t *)previousRow;
+
+    for (int n = nodes; n < denseStride; n++)
+        visited[n] = -1;
+    width[source] = HUGE_VAL;
+    hops[source] = 0;
+
+    while(true)
+    {
+        //widest unvisited vertex; visited ones count as narrower than unreached (-1)
+        DoubleLanes best = DoubleLanes{} - 2;
+        for (int b = 0; b < blocks; b++)
+        {
+            DoubleLanes key = visitedRow[b] ? DoubleLanes{} - 2 : widthRow[b];
+            best = (key > best) ? key : best;
+        }
+        double w = maxLane(best);
+        if(w < 0)
+            break;
+
+        //fewest hops among those
+        LongLanes fewest = LongLanes{} + INF_DIST;
+        for (int b = 0; b < blocks; b++)
+        {
+            LongLanes key = (~visitedRow[b] & (widthRow[b] == w)) ? hopsRow[b] : LongLanes{} + INF_DIST;
+            fewest = (key < fewest) ? key : fewest;
+        }
+        int64_t h = minLane(fewest);
+
+        int u = 0;
+        while(visited[u] || width[u] != w || hops[u] != h)
+            u++;
+        visited[u] = -1;
+        COUNT(count.pops++);
+
+        if(u == destination)
+            break;
+
+        //relax u's row
+        const HalfIntLanes *freeRow = (const HalfIntLanes *)&d.freeCircuits[(size_t)u * denseStride / INT_LANES];
+        const DoubleLanes *divRow = &d.divisor[(size_t)u * blocks];
+        const HalfIntLanes *linkRow = (const HalfIntLanes *)&denseLinkId[(size_t)u * denseStride / INT_LANES];
+        DoubleLanes wu = DoubleLanes{} + width[u];
+        LongLanes hu = LongLanes{} + (hops[u] + 1);
+        for (int b = 0; b < blocks; b++)
+        {
+            DoubleLanes free = __builtin_convertvector(freeRow[b], DoubleLanes);
+            DoubleLanes linkWidth = free / divRow[b];
+            DoubleLanes wj = (linkWidth < wu) ? linkWidth : wu;
+            COUNT(count.relaxations += setLanes((free > 0) & ~visitedRow[b]));
+            LongLanes better = (free > 0) & ~visitedRow[b] & ((wj > widthRow[b]) | ((wj == widthRow[b]) & (hu < hopsRow[b])));
+            widthRow[b] = better ? wj : widthRow[b];
+            hopsRow[b] = better ? hu : hopsRow[b];
+            previousRow[b] = better ? __builtin_convertvector(linkRow[b], LongLanes) : previousRow[b];
+        }
+    }
+
+    if(!visited[destination])
+        return false;
+
+    //only the path is kept in ws, for the fewest-hops phase shared with widestPath()
+    for (int curr = destination; previous[curr] > -1; curr = otherEnd(previous[curr], curr))
+        ws.reach(curr).previousLink = previous[curr];
+    ws.reach(source);
+    const double *div = (const double *)d.divisor.data();
+    fewestHopsAtWidth(source, destination, [&](int l)
+    {
+        return st.availCap[l] / div[(size_t)links[l].first * denseStride + links[l].second];
+    }, st.freeLinks, ws, count);
+    return true;
+}
+
+
+
+
+//the dense searches for the loaded topology: the smallest fixed-size instantiation that holds it, else
+//the general one. Set by chooseDenseSearches()
+typedef bool (*DenseSearch)(SimState &, int, int, SearchWorkspace &, Counters &);
+DenseSearch denseShortest = denseShortestPath<0>;
+DenseSearch denseWidest = denseWidestPath<0>;
+
+//the searches instantiated for each row length up to FIXED_BLOCKS; index 0 is the general one
+template <int... BLOCKS>
+class DenseSearchTable
+{
+    public:
+        static constexpr DenseSearch shortest[] = {denseShortestPath<BLOCKS>...};
+        static constexpr DenseSearch widest[] = {denseWidestPath<BLOCKS>...};
+};
+typedef DenseSearchTable<0, 1, 2, 3, 4, 5, 6, 7, FIXED_BLOCKS> DenseSearches;
+
+//pick the instantiations for denseStride
+void chooseDenseSearches()
+{
+    int blocks = denseStride / INT_LANES;
+    if(blocks > FIXED_BLOCKS)
+        blocks = 0;
+    denseShortest = DenseSearches::shortest[blocks];
+    denseWidest = DenseSearches::widest[blocks];
+}
+
+
+
+
+//set up the dense matrices of a run of Policy, if the dense engine is in use. Additive weights are taken
+//once: they may depend on the network only through whether a link has free circuits
+template <class Policy>
+void prepareDense(SimState &st)
+{
+    if(!denseEngine)
+        return;
+
+    DenseNetwork &d = st.dense;
+    size_t cells = (size_t)denseStride * denseStride;
+    d.freeCircuits.assign(cells / INT_LANES, IntLanes{});
+    for (int l = 0; l < links.size(); l++)
+        d.setFree(l, st.availCap[l]);
+
+    if constexpr (Policy::BOTTLENECK)
+    {
+        d.divisor.assign(cells / DOUBLE_LANES, DoubleLanes{} + 1);
+        double *div = (double *)d.divisor.data();
+        for (int l = 0; l < links.size(); l++)
+        {
+            div[(size_t)links[l].first * denseStride + links[l].second] = Policy::widthDivisor(st, l);
+            div[(size_t)links[l].second * denseStride + links[l].first] = Policy::widthDivisor(st, l);
+        }
+    }
+    else
+    {
+        d.cost.assign(cells / INT_LANES, FloatLanes{});
+        float *cost = (float *)d.cost.data();
+        for (int l = 0; l < links.size(); l++)
+        {
+            //the weight of l while it has circuits free, even if it starts saturated (a resumed run)
+            int held = st.availCap[l];
+            st.availCap[l] = max(held, 1);
+            float c = Policy::linkCost(st, l);
+            st.availCap[l] = held;
+            cost[(size_t)links[l].first * denseStride + links[l].second] = c;
+            cost[(size_t)links[l].second * denseStride + links[l].first] = c;
+        }
+    }
+    d.active = true;
+}
+
+
+
+
+//search the network between 2 points and route the call over the path found: with the additive
+//shortestPath() under linkValue as edge weights, or with the bottleneck widestPath() under linkValue
+//as link widths if Widest. The call is routed only if the path found has at most maxHops links
+template <bool Widest, class Value>
+bool updateState(SimState &st, int source, int destination, const Value &linkValue, double endTime, int maxHops)
+{
+    SearchWorkspace &ws = st.search;
+
+    //quit early if the endpoints are in different components
+    if(source >= 0 && destination >= 0 && !st.components.connected(source, destination))
+    {
+        COUNT(st.counters.fastBlocks++);
+        return false;
+    }
+
+    //quit if no path was found. A search failing on connected endpoints means saturated links have split
+    //the components since the last rebuild: refresh them so the next calls between the parts skip the search
+    COUNT(st.counters.searches++);
+    bool found;
+    if(st.dense.active)
+        found = Widest ? denseWidest(st, source, destination, ws, st.counters)
+                       : denseShortest(st, source, destination, ws, st.counters);
+    else if constexpr (Widest)
+        found = widestPath(source, destination, linkValue, st.freeLinks, ws, st.counters);
+    else
+        found = shortestPath(source, destination, linkValue, st.freeLinks, ws, st.counters);
+    if(!found)
+    {
+        if(st.components.stale && source >= 0 && destination >= 0)
+            st.components.rebuild(st.availCap);
+        return false;
+    }
+
+    //quit if the path is longer than allowed
+    int hops = 0;
+    for (int curr = destination; ws.previous(curr) > -1; curr = otherEnd(ws.previous(curr), curr))
+        hops++;
+    if(hops > maxHops)
+    {
+        return false;
+    }
+
+
+    //update topology state and statistics
+    ActiveCall &call = admitCall(st, endTime);
+    int curr = destination; 
+
+    while(ws.previous(curr) > -1)
+    { 
+        int l = ws.previous(curr);
+        holdLink(st, call, l);
+
+        //update loop iterator
+        curr = otherEnd(l, curr);
+    }
+
+    return true;
+            
+
+
+} //end updateState
+
+
+
+
+//route a call over the first of its cached candidate paths with a free circuit on every link.
+//returns false if none fits (the caller then falls back to a full search)
+template <class Cost>
+bool routeFromCache(SimState &st, int source, int destination, const Cost &staticCost, double endTime, int maxHops)
+{
+    const vector< vector<int> > &paths = st.routes.candidates(source, destination, kPaths, staticCost);
+
+    for (int p = 0; p < paths.size(); p++)
+    {
+        bool fits = (paths[p].size() <= maxHops);
+        for (int k = 0; k < paths[p].size() && fits; k++)
+            fits = (st.availCap[paths[p][k]] > 0);
+
+        if(fits)
+        {
+            ActiveCall &call = admitCall(st, endTime);
+            for (int k = 0; k < paths[p].size(); k++)
+                holdLink(st, call, paths[p][k]);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+///Routing policies////////////////////////////////////////////
+
+//A policy plugs into the shared engine simulate<Policy>() through these static members:
+//    BOTTLENECK                true if the policy maximizes the narrowest link of its path; it then supplies
+//    linkWidth(st, l)          the width of link l on the current network, searched by widestPath(), which
+//    widthDivisor(st, l)       must equal availCap[l] / widthDivisor(st, l) for the dense engine; and
+//    linkCost(st, l)           otherwise the additive weight of link l, searched by shortestPath()
+//    maxHops(st, src, dst)     admission rule: the call is blocked if its route would need more links
+//    STATIC_COST               true if link weights never change; the policy then also supplies
+//    staticCost(l)             that fixed weight, and may route from precomputed candidate paths
+//To add a policy, write a class like the ones below and list it in policyTable.
+
+
+//shortest hop path first: unit weight on every link with free circuits
+class SHPFPolicy
+{
+    public:
+        static float linkCost(const SimState &st, int l) { return costSHPF(st, l); }
+        static const bool BOTTLENECK = false;
+        static int maxHops(SimState &, int, int) { return INT_MAX; }
+        static const bool STATIC_COST = true;
+        static float staticCost(int) { return 1; }
+};
+
+
+//shortest delay path first: fixed propagation delays
+class SDPFPolicy
+{
+    public:
+        static float linkCost(const SimState &, int l) { return propDelay[l]; }
+        static const bool BOTTLENECK = false;
+        static int maxHops(SimState &, int, int) { return INT_MAX; }
+        static const bool STATIC_COST = true;
+        static float staticCost(int l) { return propDelay[l]; }
+};
+
+
+//least loaded path: minimize the utilization of the busiest link
+class LLPPolicy
+{
+    public:
+        static const bool BOTTLENECK = true;
+        static double linkWidth(const SimState &st, int l) { return widthLLP(st, l); }
+        static double widthDivisor(const SimState &st, int l) { return st.linkCapacity[l]; }
+        static int maxHops(SimState &, int, int) { return INT_MAX; }
+        static const bool STATIC_COST = false;
+};
+
+
+//maximum free circuits: maximize the free circuits of the fullest link
+class MFCPolicy
+{
+    public:
+        static const bool BOTTLENECK = true;
+        static double linkWidth(const SimState &st, int l) { return widthMFC(st, l); }
+        static double widthDivisor(const SimState &, int) { return 1; }
+        static int maxHops(SimState &, int, int) { return INT_MAX; }
+        static const bool STATIC_COST = false;
+};
+
+
+//shortest hop path only: route as SHPF, but block calls whose loaded hop count exceeds the empty network's
+class SHPOPolicy
+{
+    public:
+        static float linkCost(const SimState &st, int l) { return costSHPF(st, l); }
+        static const bool BOTTLENECK = false;
+        static int maxHops(SimState &st, int src, int dst)
+        {
+            if(src < 0 || dst < 0)
+                return INT_MAX;
+            return st.emptyHops.hops(src, dst);
+        }
+        static const bool STATIC_COST = false;
+};
+
+
+
+
+///Checkpoints//////////////////////////////////////////////
+
+//A run with checkpointEvery > 0 writes a snapshot of its state every checkpointEvery calls, so a long replay
+//that dies can resume from the last one instead of call 0, and what-if runs can start from a warmed-up
+//network. Layout, in native byte order:
+//    SnapshotHeader
+//    availCap of each link
+//    the active calls: uint64_t count, then for each its end time, uint32_t link count and links
+//    the run's statistics, WindowStats and Counters
+//    where the run is in its workload: nothing for a loaded workload (nextCall indexes it), a StreamPosition
+//    per workload when streaming, or the CallGenerator state when generating
+//Snapshots can only be read back against the same topology and capacities (see networkHash())
+const char SNAPSHOT_MAGIC[8] = {'R','T','S','N','A','P','S','H'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+long checkpointEvery = 0;       //calls between snapshots (0: none)
+string checkpointPath;          //each run writes checkpointPath.POLICY
+
+enum WorkloadKind : uint32_t { LOADED_WORKLOAD, STREAMED_WORKLOAD, GENERATED_WORKLOAD };
+
+class SnapshotHeader
+{
+    public:
+        char magic[8];
+        uint32_t version;
+        uint32_t kind;              //WorkloadKind of the run
+        uint64_t nodeCount;
+        uint64_t linkCount;
+        uint64_t networkHash;
+        uint64_t nextCall;          //first call not yet routed
+        uint64_t activeCalls;
+        char policy[16];            //policy of the run that wrote it
+};
+
+//FNV-1a over the links and capacities of a run, so a snapshot is never applied to another network
+uint64_t networkHash(const SimState &st)
+{
+    uint64_t h = 14695981039346656037ULL;
+    auto mix = [&h](uint64_t v)
+    {
+        for (int b = 0; b < 8; b++, v >>= 8)
+            h = (h ^ (v & 0xff)) * 1099511628211ULL;
+    };
+    for (int l = 0; l < links.size(); l++)
+    {
+        mix(links[l].first);
+        mix(links[l].second);
+        mix(st.linkCapacity[l]);
+    }
+    return h;
+}
+
+WorkloadKind workloadKind(const SimState &st)
+{
+    return st.generator ? GENERATED_WORKLOAD : (streaming ? STREAMED_WORKLOAD : LOADED_WORKLOAD);
+}
+
+template <class T>
+void putValue(FILE *out, const T &value)
+{
+    fwrite(&value, sizeof(T), 1, out);
+}
+
+template <class T>
+void putVector(FILE *out, const vector<T> &values)
+{
+    putValue(out, (uint64_t)values.size());
+    fwrite(values.data(), sizeof(T), values.size(), out);
+}
+
+//write the state of st, about to route call nextCall, to checkpointPath.POLICY. The snapshot goes to a
+//temporary file renamed over the last one, so a crash while writing leaves the previous snapshot intact
+void writeSnapshot(SimState &st, int nextCall)
+{
+    string path = checkpointPath + "." + st.policy;
+    string temporary = path + ".tmp";
+    FILE *out = fopen(temporary.c_str(), "wb");
+    if(out == NULL)
+    {
+        cerr << "error: cannot write " << temporary << endl;
+        exit(1);
+    }
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    h.version = SNAPSHOT_VERSION;
+    h.kind = workloadKind(st);
+    h.nodeCount = nodeNames.size();
+    h.linkCount = links.size();
+    h.networkHash = networkHash(st);
+    h.nextCall = nextCall;
+    h.activeCalls = st.departures.size();
+    strncpy(h.policy, st.policy, sizeof(h.policy) - 1);
+    putValue(out, h);
+    fwrite(st.availCap.data(), sizeof(int), st.availCap.size(), out);
+
+    //the calls in progress, earliest departure first
+    priority_queue< Departure, vector<Departure>, greater<Departure> > pending = st.departures;
+    for (; !pending.empty(); pending.pop())
+    {
+        const PathRecord &path = st.calls[pending.top().slot].path;
+        putValue(out, pending.top().endTime);
+        putValue(out, (uint32_t)path.size());
+        for (int j = 0; j < path.size(); j++)
+            putValue(out, (int32_t)path[j]);
+    }
+
+    double totals[6] = {st.blockedCalls, st.succCalls, st.totalSuccCalls, st.totalCalls, st.totalHops, st.totalProp};
+    putValue(out, totals);
+    putValue(out, st.window);
+
+    const Counters &c = st.counters;
+    long work[6] = {c.searches, c.pops, c.relaxations, c.fastBlocks, c.reclaims, c.departed};
+    putValue(out, work);
+    putValue(out, c.departHistogram);
+    putValue(out, (uint64_t)c.peakActive);
+    putVector(out, c.leastFree);
+
+    if(h.kind == STREAMED_WORKLOAD)
+        putVector(out, st.streamReader.positions());
+    else if(h.kind == GENERATED_WORKLOAD)
+    {
+        string engine;
+        double clock;
+        long made;
+        st.generator->save(engine, clock, made);
+        putValue(out, clock);
+        putValue(out, (int64_t)made);
+        putVector(out, vector<char>(engine.begin(), engine.end()));
+    }
+
+    if(ferror(out) | fclose(out) || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        cerr << "error: writing " << path << " failed" << endl;
+        exit(1);
+    }
+}
+
+//reads a snapshot, exiting with a message on any damage
+class SnapshotReader
+{
+    public:
+        SnapshotReader(const string &path) : fileName(path)
+        {
+            in = fopen(path.c_str(), "rb");
+        }
+
+        ~SnapshotReader()
+        {
+            if(in)
+                fclose(in);
+        }
+
+        bool isOpen() const
+        {
+            return in != NULL;
+        }
+
+        template <class T>
+        void get(T &value)
+        {
+            if(fread(&value, sizeof(T), 1, in) != 1)
+                fail("truncated snapshot");
+        }
+
+        template <class T>
+        void getArray(T *values, size_t count)
+        {
+            if(fread(values, sizeof(T), count, in) != count)
+                fail("truncated snapshot");
+        }
+
+        template <class T>
+        void getVector(vector<T> &values, uint64_t limit)
+        {
+            uint64_t count;
+            get(count);
+            if(count > limit)
+                fail("damaged snapshot");
+            values.resize(count);
+            getArray(values.data(), count);
+        }
+
+        void fail(const string &message) const
+        {
+            cerr << fileName << ": " << message << endl;
+            exit(1);
+        }
+
+    private:
+        string fileName;
+        FILE *in = NULL;
+};
+
+//set up st, not yet run, from the snapshot at path: the network and calls in progress, the statistics so
+//far, and where to pick up the workload. The snapshot may come from a run of another policy.
+//False if there is no such file
+bool readSnapshot(SimState &st, const string &path)
+{
+    SnapshotReader in(path);
+    if(!in.isOpen())
+        return false;
+
+    SnapshotHeader h;
+    in.get(h);
+    if(memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || h.version != SNAPSHOT_VERSION)
+        in.fail("not a version " + to_string(SNAPSHOT_VERSION) + " snapshot");
+    if(h.nodeCount != nodeNames.size() || h.linkCount != links.size() || h.networkHash != networkHash(st))
+        in.fail("snapshot of a different topology or link capacities");
+    if(h.kind != workloadKind(st))
+        in.fail("snapshot of a run with another kind of workload (loaded, --stream or --generate)");
+    if(h.nextCall > INT_MAX || (h.kind == LOADED_WORKLOAD && h.nextCall > eventQueue.size()))
+        in.fail("snapshot is past the end of the workload");
+
+    //network, with the usable links and components rebuilt
+    in.getArray(st.availCap.data(), links.size());
+    st.freeLinks.reset();
+    for (int l = 0; l < links.size(); l++)
+    {
+        if(st.availCap[l] < 0 || st.availCap[l] > st.linkCapacity[l])
+            in.fail("damaged snapshot");
+        if(st.availCap[l] > 0)
+            st.freeLinks.set(l);
+    }
+    st.components.rebuild(st.availCap);
+
+    //calls in progress
+    for (uint64_t k = 0; k < h.activeCalls; k++)
+    {
+        double endTime;
+        uint32_t length;
+        in.get(endTime);
+        in.get(length);
+        ActiveCall &call = admitCall(st, endTime);
+        for (uint32_t j = 0; j < length; j++)
+        {
+            int32_t l;
+            in.get(l);
+            if(l < 0 || l >= links.size())
+                in.fail("damaged snapshot");
+            call.path.push(l);
+        }
+    }
+
+    double totals[6];
+    in.get(totals);
+    st.blockedCalls = totals[0];
+    st.succCalls = totals[1];
+    st.totalSuccCalls = totals[2];
+    st.totalCalls = totals[3];
+    st.totalHops = totals[4];
+    st.totalProp = totals[5];
+    in.get(st.window);
+
+    Counters &c = st.counters;
+    long work[6];
+    in.get(work);
+    c.searches = work[0];
+    c.pops = work[1];
+    c.relaxations = work[2];
+    c.fastBlocks = work[3];
+    c.reclaims = work[4];
+    c.departed = work[5];
+    in.get(c.departHistogram);
+    uint64_t peak;
+    in.get(peak);
+    c.peakActive = peak;
+    vector<int> leastFree;
+    in.getVector(leastFree, links.size());
+    //a snapshot from a build without counters has none to carry over
+    COUNT(c.leastFree = (leastFree.size() == links.size()) ? leastFree : st.availCap);
+
+    if(h.kind == STREAMED_WORKLOAD)
+    {
+        in.getVector(st.resumeAt, workloadPaths.size());
+        if(st.resumeAt.size() != workloadPaths.size())
+            in.fail("snapshot of a run over a different number of workloads");
+    }
+    else if(h.kind == GENERATED_WORKLOAD)
+    {
+        double clock;
+        int64_t made;
+        vector<char> engine;
+        in.get(clock);
+        in.get(made);
+        in.getVector(engine, 1 << 20);
+        if(made != h.nextCall || !st.generator->restore(string(engine.begin(), engine.end()), clock, made))
+            in.fail("damaged snapshot");
+    }
+
+    st.firstCall = h.nextCall;
+    return true;
+}
+
+
+
+
+//monotonic clock in nanoseconds, for benchmark timings
+inline int64_t clockNanos()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//run a policy over the workload; the one event loop shared by all policies
+template <class Policy>
+bool routeCall(SimState &st, const CallEvent &call);
+
+template <class Policy>
+void simulate(SimState &st)
+{
+    CallEvent call;
+    prepareDense<Policy>(st);
+
+    //precompute candidate paths for the pairs of the loaded workload
+    if constexpr (Policy::STATIC_COST)
+    {
+        for (int i = 0; kPaths > 0 && i < eventQueue.size(); i++)
+            st.routes.candidates(eventQueue.source[i], eventQueue.destination[i], kPaths, Policy::staticCost);
+    }
+
+    //for each event in arrival order
+    for (int i = st.firstCall; nextCall(st, i, call); i++)
+    {
+        int64_t start = st.timing ? clockNanos() : 0;
+
+        //handle time related event updates
+        timeUpdate(st, call.startTime);
+
+        int64_t reclaimed = st.timing ? clockNanos() : 0;
+
+        //run djikstra's algorithm on current event to determine reachability and update statistics as such
+        bool routed = routeCall<Policy>(st, call);
+        COUNT(st.counters.peakActive = max(st.counters.peakActive, st.departures.size()));
+
+        if(st.timing)
+        {
+            int64_t done = clockNanos();
+            st.reclaimNanos += reclaimed - start;
+            st.routeNanos.push_back(done - reclaimed);
+        }
+
+        if(routed)
+        {
+            //path available
+            st.succCalls++;
+        }
+        else
+        {
+            //no path available
+            st.blockedCalls++;
+        }
+
+        if(checkpointEvery > 0 && (i + 1) % checkpointEvery == 0)
+            writeSnapshot(st, i + 1);
+    }
+
+    //let the calls still in progress depart, so the run ends on the simulated clock of its last event
+    while(!st.departures.empty())
+        timeUpdate(st, st.departures.top().endTime);
+
+    //the last, partial window ends with the last event
+    if(windowWidth > 0 && st.window.clock > st.window.start)
+        closeWindow(st, st.window.clock);
+
+    //calculate statistics
+    st.avgProp = st.totalProp/st.succCalls;
+    st.avgHop = st.totalHops/st.succCalls;
+    st.succPercent = st.succCalls/st.totalCalls *100;
+    st.blockedPercent = st.blockedCalls/st.totalCalls *100;
+}
+
+
+
+
+//route one call: try the cached candidate paths of fixed-cost policies, else search the network
+template <class Policy>
+bool routeCall(SimState &st, const CallEvent &call)
+{
+    int maxHops = Policy::maxHops(st, call.source, call.destination);
+
+    if constexpr (Policy::STATIC_COST)
+    {
+        if(kPaths > 0 && routeFromCache(st, call.source, call.destination, Policy::staticCost, call.endTime, maxHops))
+            return true;
+    }
+
+    if constexpr (Policy::BOTTLENECK)
+        return updateState<true>(st, call.source, call.destination,
+                                 [&st](int l) { return Policy::linkWidth(st, l); }, call.endTime, maxHops);
+    else
+        return updateState<false>(st, call.source, call.destination,
+                                  [&st](int l) { return Policy::linkCost(st, l); }, call.endTime, maxHops);
+}
+
+
+
+
+///Sharded runs////////////////////////////////////////////
+
+//In a sharded run the nodes are split into regions. Each region is simulated by its own shard: a SimState
+//owning the region's links (those with both ends in it) and routing the calls between its nodes over them
+//alone. Links between regions are trunks, owned by the run's main state, which routes the cross-region
+//calls over the whole network. The shards run in parallel up to the arrival of the next cross-region call,
+//the lookahead: until then no event of one shard can touch another's links. At that barrier the main
+//state takes the shards' link states, routes the call, and hands each shard the circuits it took there.
+int shardCount = 0;             //regions to split each run into (0: run unsharded)
+vector<int> nodeRegion;         //region of each node
+vector<int> linkRegion;         //region owning each link; -1 for trunks
+
+//split the nodes into shardCount regions of about equal size, each grown breadth first from its lowest
+//unassigned node so that regions are connected where the topology allows and cut few links
+void partitionRegions()
+{
+    //every region needs a node of its own
+    int nodes = nodeNames.size();
+    shardCount = min(shardCount, nodes);
+    nodeRegion.assign(nodes, -1);
+    int region = 0, regionSize = 0;
+    vector<int> frontier;
+    for (int seed = 0; seed < nodes; seed++)
+    {
+        if(nodeRegion[seed] >= 0)
+            continue;
+
+        //region r takes nodes up to the (r+1)-th share of all nodes
+        int quota = (long)nodes * (region + 1) / shardCount - (long)nodes * region / shardCount;
+        int size = 0;
+        frontier.assign(1, seed);
+        nodeRegion[seed] = region;
+        for (int f = 0; f < frontier.size() && regionSize + size < quota; f++)
+        {
+            int u = frontier[f];
+            size++;
+            for (int e = graph.offset[u]; e < graph.offset[u+1]; e++)
+            {
+                int j = graph.neighbour[e];
+                if(nodeRegion[j] < 0)
+                {
+                    nodeRegion[j] = region;
+                    frontier.push_back(j);
+                }
+            }
+        }
+
+        //nodes queued past the quota go back to the pool
+        for (int f = size; f < frontier.size(); f++)
+            nodeRegion[frontier[f]] = -1;
+
+        //a region cut short by a disconnected topology is topped up from the next seed
+        regionSize += size;
+        if(regionSize >= quota && region < shardCount - 1)
+        {
+            region++;
+            regionSize = 0;
+        }
+    }
+}
+
+//read the region of each node, one "node region" per line. Nodes not listed form one more region
+bool loadRegions(const string &path)
+{
+    LineReader in;
+    if(!in.open(path))
+        return false;
+
+    nodeRegion.assign(nodeNames.size(), -1);
+    const char *begin, *end;
+    string key;
+    while(in.next(begin, end))
+    {
+        if(blankLine(begin, end))
+            continue;
+
+        const char *fieldBegin[2], *fieldEnd[2];
+        int r;
+        if(!splitFields(begin, end, 2, fieldBegin, fieldEnd) || !parseNumber(fieldBegin[1], fieldEnd[1], r) || r < 0)
+            inputError(in, "expected 'node region'");
+        key.assign(fieldBegin[0], fieldEnd[0]);
+        int n = findNode(key);
+        if(n < 0)
+            inputError(in, "node is not in the topology");
+        nodeRegion[n] = r;
+    }
+
+    //region ids as listed need not be dense: number the regions used 0, 1, .. in id order
+    vector<int> ids;
+    for (int n = 0; n < nodeRegion.size(); n++)
+    {
+        if(nodeRegion[n] >= 0)
+            ids.push_back(nodeRegion[n]);
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    int regions = ids.size();
+
+    bool unlisted = false;
+    for (int n = 0; n < nodeRegion.size(); n++)
+    {
+        if(nodeRegion[n] >= 0)
+            nodeRegion[n] = lower_bound(ids.begin(), ids.end(), nodeRegion[n]) - ids.begin();
+        else
+        {
+            nodeRegion[n] = regions;
+            unlisted = true;
+        }
+    }
+    shardCount = regions + unlisted;
+    return true;
+}
+
+//owner of each link from nodeRegion: its region if both ends share one, else the trunks (-1)
+void assignLinkRegions()
+{
+    linkRegion.resize(links.size());
+    for (int l = 0; l < links.size(); l++)
+    {
+        int a = nodeRegion[links[l].first];
+        int b = nodeRegion[links[l].second];
+        linkRegion[l] = (a == b) ? a : -1;
+    }
+}
+
+//true if every node is in one of the shardCount regions
+bool regionsComplete()
+{
+    for (int n = 0; n < nodeRegion.size(); n++)
+    {
+        if(nodeRegion[n] < 0 || nodeRegion[n] >= shardCount)
+            return false;
+    }
+    return true;
+}
+
+
+
+
+//a fixed team of threads working in phases: runPhase() runs work(0) .. work(members-1) once each,
+//member 0 on the calling thread, and returns when all are done. Threads persist across phases
+class ThreadTeam
+{
+    public:
+        ThreadTeam(int members, const function<void(int)> &w) : work(w)
+        {
+            for (int m = 1; m < members; m++)
+                threads.push_back( thread([this, m]() { serve(m); }) );
+        }
+
+        ~ThreadTeam()
+        {
+            {
+                lock_guard<mutex> hold(lock);
+                stopping = true;
+                phase++;
+            }
+            started.notify_all();
+            for (int t = 0; t < threads.size(); t++)
+                threads[t].join();
+        }
+
+        void runPhase()
+        {
+            {
+                lock_guard<mutex> hold(lock);
+                pending = threads.size();
+                phase++;
+            }
+            started.notify_all();
+
+            work(0);
+
+            unique_lock<mutex> hold(lock);
+            finished.wait(hold, [this]() { return pending == 0; });
+        }
+
+    private:
+        void serve(int m)
+        {
+            long seen = 0;
+            while(true)
+            {
+                {
+                    unique_lock<mutex> hold(lock);
+                    started.wait(hold, [&]() { return phase != seen; });
+                    seen = phase;
+                    if(stopping)
+                        return;
+                }
+
+                work(m);
+
+                lock_guard<mutex> hold(lock);
+                if(--pending == 0)
+                    finished.notify_one();
+            }
+        }
+
+        function<void(int)> work;
+        vector<thread> threads;
+        mutex lock;
+        condition_variable started, finished;
+        long phase = 0;
+        int pending = 0;
+        bool stopping = false;
+};
+
+
+
+
+//run a policy over the workload split across shards (see above). The workload must be loaded in eventQueue
+template <class Policy>
+void simulateSharded(SimState &st)
+{
+    //a shard sees only its own links: every other link has no free circuit in it
+    deque<SimState> shards;
+    for (int r = 0; r < shardCount; r++)
+    {
+        shards.emplace_back(st.scenario, st.replication);
+        for (int l = 0; l < links.size(); l++)
+        {
+            if(linkRegion[l] != r)
+                setFreeCircuits(shards[r], l, 0);
+        }
+        shards[r].components.rebuild(shards[r].availCap);
+        prepareDense<Policy>(shards[r]);
+    }
+    prepareDense<Policy>(st);
+
+    //calls by shard, in arrival order, and the cross-region calls that bound each phase
+    vector< vector<int> > intra(shardCount);
+    vector<int> cross;
+    for (int i = 0; i < eventQueue.size(); i++)
+    {
+        int src = eventQueue.source[i], dst = eventQueue.destination[i];
+        if(src >= 0 && dst >= 0 && nodeRegion[src] == nodeRegion[dst])
+            intra[nodeRegion[src]].push_back(i);
+        else
+            cross.push_back(i);
+    }
+
+    //a phase routes each shards calls before call index limit, then reclaims its circuits freed by limitTime.
+    //Team member m runs shards m, m + members, ..
+    vector<int> next(shardCount, 0);
+    int limit = 0;
+    double limitTime = 0;
+    int workers = (threadCount > 0) ? threadCount : max(1u, thread::hardware_concurrency());
+    int members = min(shardCount, workers);
+    ThreadTeam team(members, [&](int m)
+    {
+        CallEvent call;
+        for (int r = m; r < shardCount; r += members)
+        {
+            SimState &shard = shards[r];
+            for (; next[r] < intra[r].size() && intra[r][next[r]] < limit; next[r]++)
+            {
+                nextCall(shard, intra[r][next[r]], call);
+                timeUpdate(shard, call.startTime);
+                if(routeCall<Policy>(shard, call))
+                    shard.succCalls++;
+                else
+                    shard.blockedCalls++;
+            }
+            timeUpdate(shard, limitTime);
+        }
+    });
+
+    CallEvent call;
+    for (int c = 0; c < cross.size(); c++)
+    {
+        //run the shards up to the cross-region call
+        nextCall(st, cross[c], call);
+        limit = cross[c];
+        limitTime = call.startTime;
+        team.runPhase();
+
+        //take the current state of the shards links, and free the trunks of departed cross-region calls
+        for (int l = 0; l < links.size(); l++)
+        {
+            if(linkRegion[l] >= 0)
+                setFreeCircuits(st, l, shards[linkRegion[l]].availCap[l]);
+        }
+        timeUpdate(st, call.startTime);
+
+        if(!routeCall<Policy>(st, call))
+        {
+            st.blockedCalls++;
+            continue;
+        }
+        st.succCalls++;
+
+        //the circuits taken inside regions are held, and given back, by their shards; the trunks stay here
+        ActiveCall &routed = st.calls[st.lastAdmitted];
+        PathRecord path = routed.path;
+        routed.path.clear();
+        vector<int> held(shardCount, -1);   //(index- region; elem- pool slot of its share of the call)
+        for (int k = 0; k < path.size(); k++)
+        {
+            int r = linkRegion[path[k]];
+            if(r < 0)
+            {
+                routed.path.push(path[k]);
+                continue;
+            }
+            if(held[r] < 0)
+            {
+                admitCall(shards[r], call.endTime);
+                held[r] = shards[r].lastAdmitted;
+            }
+            shards[r].calls[held[r]].path.push(path[k]);
+            takeCircuit(shards[r], path[k]);
+        }
+    }
+
+    //the calls after the last cross-region call
+    limit = INT_MAX;
+    limitTime = HUGE_VAL;
+    team.runPhase();
+    while(!st.departures.empty())
+        timeUpdate(st, st.departures.top().endTime);
+
+    //the shards statistics join the cross-region ones
+    for (int r = 0; r < shardCount; r++)
+    {
+        st.succCalls += shards[r].succCalls;
+        st.blockedCalls += shards[r].blockedCalls;
+        st.totalHops += shards[r].totalHops;
+        st.totalProp += shards[r].totalProp;
+    }
+
+    st.avgProp = st.totalProp/st.succCalls;
+    st.avgHop = st.totalHops/st.succCalls;
+    st.succPercent = st.succCalls/st.totalCalls *100;
+    st.blockedPercent = st.blockedCalls/st.totalCalls *100;
+}
+
+
+
+
+///Batched runs////////////////////////////////////////////
+
+//In a batched run consecutive arrivals are routed in batches: their searches run in parallel, speculatively,
+//on the network as it is when the batch starts, then the calls are committed in arrival order. A batch ends
+//before the next departure (of earlier calls or of its own), so nothing is freed while it is open and the
+//only changes it sees are its own commits. A speculative result is then exact unless an earlier commit of
+//the batch changed a link the search could have relaxed, one with an end the search reached; those calls
+//alone are routed again on the current network. Taking circuits never unblocks a call, so speculative
+//blocks always stand. Results are identical to an unbatched run.
+int batchSize = 0;              //most calls per batch (0: run unbatched)
+
+//the speculative search of one call of a batch
+class SpeculativeRoute
+{
+    public:
+        CallEvent call;
+        bool found = false;
+        SearchWorkspace search;
+        Counters counters;
+};
+
+template <class Policy>
+void simulateBatched(SimState &st)
+{
+    prepareDense<Policy>(st);
+    int workers = (threadCount > 0) ? threadCount : max(1u, thread::hardware_concurrency());
+    vector<SpeculativeRoute> batch(batchSize);
+    int batchCalls = 0;
+
+    //the searches only read the network, and each writes its own result
+    ThreadTeam team(workers, [&](int m)
+    {
+        for (int b = m; b < batchCalls; b += workers)
+        {
+            SpeculativeRoute &s = batch[b];
+            int src = s.call.source, dst = s.call.destination;
+            if constexpr (Policy::BOTTLENECK)
+                s.found = widestPath(src, dst, [&st](int l) { return Policy::linkWidth(st, l); },
+                                     st.freeLinks, s.search, s.counters);
+            else
+                s.found = shortestPath(src, dst, [&st](int l) { return Policy::linkCost(st, l); },
+                                       st.freeLinks, s.search, s.counters);
+        }
+    });
+
+    vector<int> changed;        //links whose cost the commits of the batch have changed so far
+    CallEvent call;
+    bool pending = nextCall(st, 0, call);
+    for (int i = 0; pending; )
+    {
+        //gather arrivals up to the next departure
+        timeUpdate(st, call.startTime);
+        double nextDeparture = st.departures.empty() ? HUGE_VAL : st.departures.top().endTime;
+        batchCalls = 0;
+        while(pending && batchCalls < batchSize && (batchCalls == 0 || call.startTime < nextDeparture))
+        {
+            batch[batchCalls++].call = call;
+            nextDeparture = min(nextDeparture, call.endTime);
+            pending = nextCall(st, ++i, call);
+        }
+
+        if(batchCalls > 1)
+            team.runPhase();
+        else
+            batch[0].found = true;  //a lone call is simply routed below
+
+        //commit in arrival order
+        changed.clear();
+        for (int b = 0; b < batchCalls; b++)
+        {
+            SpeculativeRoute &s = batch[b];
+            const CallEvent &c = s.call;
+            COUNT(st.counters.searches += (batchCalls > 1));
+            COUNT(st.counters.pops += s.counters.pops);
+            COUNT(st.counters.relaxations += s.counters.relaxations);
+            COUNT(s.counters = Counters());
+
+            //no call departs within a batch, but windows still close at each arrival as in simulate()
+            if(windowWidth > 0)
+                advanceWindow(st, c.startTime);
+
+            if(!s.found)
+            {
+                st.blockedCalls++;
+                continue;
+            }
+
+            //route again if a commit touched a link the search could have relaxed
+            bool stale = (batchCalls == 1);
+            for (int k = 0; k < changed.size() && !stale; k++)
+            {
+                int a = links[changed[k]].first, z = links[changed[k]].second;
+                stale = (a == c.source || z == c.source || s.search.previous(a) >= 0 || s.search.previous(z) >= 0);
+            }
+
+            bool routed;
+            if(stale)
+                routed = routeCall<Policy>(st, c);
+            else
+            {
+                //the speculative path, if it passes admission
+                int hops = 0;
+                for (int curr = c.destination; s.search.previous(curr) > -1; curr = otherEnd(s.search.previous(curr), curr))
+                    hops++;
+                routed = (hops <= Policy::maxHops(st, c.source, c.destination));
+                if(routed)
+                {
+                    ActiveCall &active = admitCall(st, c.endTime);
+                    for (int curr = c.destination; s.search.previous(curr) > -1; curr = otherEnd(s.search.previous(curr), curr))
+                        holdLink(st, active, s.search.previous(curr));
+                }
+            }
+
+            if(!routed)
+            {
+                st.blockedCalls++;
+                continue;
+            }
+            st.succCalls++;
+
+            //links of the call whose cost changed: all of them for bottleneck policies, the saturated ones otherwise
+            const PathRecord &path = st.calls[st.lastAdmitted].path;
+            for (int k = 0; k < path.size(); k++)
+            {
+                if(Policy::BOTTLENECK || st.availCap[path[k]] == 0)
+                    changed.push_back(path[k]);
+            }
+        }
+    }
+
+    while(!st.departures.empty())
+        timeUpdate(st, st.departures.top().endTime);
+    if(windowWidth > 0 && st.window.clock > st.window.start)
+        closeWindow(st, st.window.clock);
+
+    st.avgProp = st.totalProp/st.succCalls;
+    st.avgHop = st.totalHops/st.succCalls;
+    st.succPercent = st.succCalls/st.totalCalls *100;
+    st.blockedPercent = st.blockedCalls/st.totalCalls *100;
+}
+
+
+
+
+//policies known to the simulator, in reporting order
+class PolicyEntry
+{
+    public:
+        const char *name;
+        void (*run)(SimState &);
+        void (*runSharded)(SimState &);
+        void (*runBatched)(SimState &);
+};
+
+const PolicyEntry policyTable[] =
+{
+    {"SHPF", simulate<SHPFPolicy>, simulateSharded<SHPFPolicy>, simulateBatched<SHPFPolicy>},
+    {"SDPF", simulate<SDPFPolicy>, simulateSharded<SDPFPolicy>, simulateBatched<SDPFPolicy>},
+    {"LLP",  simulate<LLPPolicy>,  simulateSharded<LLPPolicy>,  simulateBatched<LLPPolicy>},
+    {"MFC",  simulate<MFCPolicy>,  simulateSharded<MFCPolicy>,  simulateBatched<MFCPolicy>},
+    {"SHPO", simulate<SHPOPolicy>, simulateSharded<SHPOPolicy>, simulateBatched<SHPOPolicy>},
+};
+const int POLICY_COUNT = sizeof(policyTable) / sizeof(policyTable[0]);
+
+
+
+
+
+
+
+//load the topology file: one link per line as "nodeA nodeB propDelay capacity".
+//Node names are arbitrary strings; node ids follow name order. Builds the adjacency lists too
+bool loadTopology(const string &path)
+{
+    LineReader in;
+    if(!in.open(path))
+        return false;
+
+    //read all rows first so every node name is known
+    vector<string> ends;
+    vector<float> delays;
+    vector<int> caps;
+    const char *begin, *end;
+
+    //while !EOF
+    while(in.next(begin, end))
+    {
+        if(blankLine(begin, end))
+            continue;
+
+        const char *fieldBegin[4], *fieldEnd[4];
+        float c;
+        int d;
+        if(!splitFields(begin, end, 4, fieldBegin, fieldEnd)
+                || !parseNumber(fieldBegin[2], fieldEnd[2], c) || !parseNumber(fieldBegin[3], fieldEnd[3], d))
+            inputError(in, "expected 'nodeA nodeB propDelay capacity'");
+
+        ends.push_back( string(fieldBegin[0], fieldEnd[0]) );
+        ends.push_back( string(fieldBegin[1], fieldEnd[1]) );
+        delays.push_back(c);
+        caps.push_back(d);
+    }
+
+    //name-to-id table
+    nodeNames = ends;
+    sort(nodeNames.begin(), nodeNames.end());
+    nodeNames.erase( unique(nodeNames.begin(), nodeNames.end()), nodeNames.end() );
+    for (int n = 0; n < nodeNames.size(); n++)
+        nodeIndex[nodeNames[n]] = n;
+
+    //per-link arrays; a repeated node pair updates its existing link
+    unordered_map<long long,int> pairLink;
+    for (int r = 0; r < delays.size(); r++)
+    {
+        int src = nodeIndex[ends[2*r]];
+        int dest = nodeIndex[ends[2*r+1]];
+        long long key = (long long)min(src, dest) * nodeNames.size() + max(src, dest);
+
+        if(pairLink.count(key) == 0)
+        {
+            pairLink[key] = links.size();
+            links.push_back( make_pair(src, dest) );
+            propDelay.push_back(0);
+            capacity.push_back(0);
+        }
+        propDelay[pairLink[key]] = delays[r];
+        capacity[pairLink[key]] = caps[r];
+    }
+
+    //adjacency lists for the route searches
+    graph.build(nodeNames.size());
+    return true;
+}
+
+
+
+
+
+
+
+///Benchmark generators////////////////////////////////////////////
+
+//settings of a generated topology. Capacities and delays are uniform over [min, max]
+class TopologySpec
+{
+    public:
+        string kind;                //grid, geometric, ba or fattree
+        int size = 0;               //nodes; for fattree the switch port count k
+        int capacityMin = 10, capacityMax = 50;
+        double delayMin = 1, delayMax = 100;
+        int attach = 2;             //ba: links added with each new node
+};
+
+//write a generated topology to path in the format of loadTopology(). Node names are n0, n1, ..
+//  grid        a near-square mesh of size nodes, linked to their right and lower neighbours
+//  geometric   size random points in the unit square, linked within the radius that connects such a
+//              graph with high probability; leftover components are chained together. The delay of a
+//              link grows with its length from delayMin to delayMax at the radius
+//  ba          Barabasi-Albert preferential attachment: each new node links to attach existing nodes
+//              chosen in proportion to their degree
+//  fattree     k-ary fat-tree (k = size, even): (k/2)^2 core, k pods of k/2 aggregation and k/2 edge
+//              switches, and k/2 hosts on each edge switch; 5k^2/4 + k^3/4 nodes
+int makeTopology(const TopologySpec &spec, const string &outPath)
+{
+    mt19937_64 rng(genConfig.seed);
+    uniform_int_distribution<int> pickCap(spec.capacityMin, spec.capacityMax);
+    uniform_real_distribution<double> pickDelay(spec.delayMin, spec.delayMax);
+
+    //links as (a, b, delay), capacities drawn when written
+    vector< tuple<int,int,double> > made;
+    int nodes = spec.size;
+
+    if(spec.kind == "grid")
+    {
+        int width = (int)ceil(sqrt((double)nodes));
+        for (int u = 0; u < nodes; u++)
+        {
+            if((u + 1) % width != 0 && u + 1 < nodes)
+                made.push_back( make_tuple(u, u + 1, pickDelay(rng)) );
+            if(u + width < nodes)
+                made.push_back( make_tuple(u, u + width, pickDelay(rng)) );
+        }
+    }
+    else if(spec.kind == "geometric")
+    {
+        double radius = sqrt(2 * log((double)max(nodes, 2)) / (M_PI * max(nodes, 2)));
+        int cells = max(1, (int)(1 / radius));
+        vector<double> x(nodes), y(nodes);
+        vector< vector<int> > cell(cells * cells);
+        uniform_real_distribution<double> coord(0, 1);
+        for (int u = 0; u < nodes; u++)
+        {
+            x[u] = coord(rng);
+            y[u] = coord(rng);
+            cell[min((int)(y[u] * cells), cells - 1) * cells + min((int)(x[u] * cells), cells - 1)].push_back(u);
+        }
+
+        //neighbours lie in the 3x3 block of cells around a point
+        for (int u = 0; u < nodes; u++)
+        {
+            int cx = min((int)(x[u] * cells), cells - 1);
+            int cy = min((int)(y[u] * cells), cells - 1);
+            for (int ny = max(cy - 1, 0); ny <= min(cy + 1, cells - 1); ny++)
+            {
+                for (int nx = max(cx - 1, 0); nx <= min(cx + 1, cells - 1); nx++)
+                {
+                    const vector<int> &c = cell[ny * cells + nx];
+                    for (int k = 0; k < c.size(); k++)
+                    {
+                        double d = hypot(x[u] - x[c[k]], y[u] - y[c[k]]);
+                        if(c[k] > u && d <= radius)
+                            made.push_back( make_tuple(u, c[k], spec.delayMin + (spec.delayMax - spec.delayMin) * d / radius) );
+                    }
+                }
+            }
+        }
+
+        //chain any components the radius left apart, so every pair can be called
+        vector<int> parent(nodes);
+        for (int u = 0; u < nodes; u++)
+            parent[u] = u;
+        function<int(int)> find = [&](int u) { return (parent[u] == u) ? u : (parent[u] = find(parent[u])); };
+        for (int k = 0; k < made.size(); k++)
+            parent[find(get<0>(made[k]))] = find(get<1>(made[k]));
+        int previous = -1;
+        for (int u = 0; u < nodes; u++)
+        {
+            if(find(u) != u)
+                continue;
+            if(previous >= 0)
+                made.push_back( make_tuple(previous, u, pickDelay(rng)) );
+            previous = u;
+        }
+    }
+    else if(spec.kind == "ba")
+    {
+        int m = max(1, spec.attach);
+        if(nodes <= m)
+        {
+            cerr << "error: ba needs more nodes than links per node" << endl;
+            return 1;
+        }
+
+        //seed clique of m+1 nodes; endpoints lists every link end, so a uniform pick is degree-weighted
+        vector<int> endpoints;
+        for (int u = 0; u <= m; u++)
+        {
+            for (int v = u + 1; v <= m; v++)
+            {
+                made.push_back( make_tuple(u, v, pickDelay(rng)) );
+                endpoints.push_back(u);
+                endpoints.push_back(v);
+            }
+        }
+        vector<int> targets;
+        for (int u = m + 1; u < nodes; u++)
+        {
+            targets.clear();
+            while(targets.size() < m)
+            {
+                int v = endpoints[uniform_int_distribution<size_t>(0, endpoints.size() - 1)(rng)];
+                if(find(targets.begin(), targets.end(), v) == targets.end())
+                    targets.push_back(v);
+            }
+            for (int t = 0; t < m; t++)
+            {
+                made.push_back( make_tuple(targets[t], u, pickDelay(rng)) );
+                endpoints.push_back(targets[t]);
+                endpoints.push_back(u);
+            }
+        }
+    }
+    else if(spec.kind == "fattree")
+    {
+        int k = spec.size;
+        if(k < 2 || k % 2 != 0)
+        {
+            cerr << "error: fattree needs an even port count" << endl;
+            return 1;
+        }
+
+        //node ids: core switches, then per pod its aggregation and edge switches, then the hosts
+        int half = k / 2;
+        int core = half * half;
+        int podSize = k;
+        int hosts = core + k * podSize;
+        nodes = hosts + k * half * half;
+        for (int p = 0; p < k; p++)
+        {
+            for (int a = 0; a < half; a++)
+            {
+                int agg = core + p * podSize + a;
+                //aggregation switch a reaches core switches a*half .. a*half+half-1
+                for (int c = 0; c < half; c++)
+                    made.push_back( make_tuple(a * half + c, agg, pickDelay(rng)) );
+                for (int e = 0; e < half; e++)
+                    made.push_back( make_tuple(agg, core + p * podSize + half + e, pickDelay(rng)) );
+            }
+            for (int e = 0; e < half; e++)
+            {
+                int edge = core + p * podSize + half + e;
+                for (int h = 0; h < half; h++)
+                    made.push_back( make_tuple(edge, hosts + (p * half + e) * half + h, pickDelay(rng)) );
+            }
+        }
+    }
+    else
+    {
+        cerr << "error: unknown topology kind " << spec.kind << " (grid, geometric, ba, fattree)" << endl;
+        return 1;
+    }
+
+    FILE *out = fopen(outPath.c_str(), "w");
+    if(out == NULL)
+    {
+        cerr << "error: cannot write " << outPath << endl;
+        return 1;
+    }
+    for (int k = 0; k < made.size(); k++)
+        fprintf(out, "n%d n%d %.3f %d\n", get<0>(made[k]), get<1>(made[k]), get<2>(made[k]), pickCap(rng));
+    if(ferror(out) | fclose(out))
+    {
+        cerr << "error: writing " << outPath << " failed" << endl;
+        return 1;
+    }
+
+    cerr << spec.kind << ": " << nodes << " nodes, " << made.size() << " links" << endl;
+    return 0;
+}
+
+
+
+
+//write calls generated calls for the loaded topology (see CallGenerator) to path as a text workload
+int makeWorkload(long calls, const string &outPath)
+{
+    FILE *out = fopen(outPath.c_str(), "w");
+    if(out == NULL)
+    {
+        cerr << "error: cannot write " << outPath << endl;
+        return 1;
+    }
+
+    genConfig.generateCalls = calls;
+    CallGenerator generator(0);
+    CallEvent call;
+    while(generator.next(call))
+    {
+        fprintf(out, "%.6f %s %s %.6f\n", call.startTime, nodeNames[call.source].c_str(),
+                nodeNames[call.destination].c_str(), call.duration);
+    }
+
+    if(ferror(out) | fclose(out))
+    {
+        cerr << "error: writing " << outPath << " failed" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+
+
+
+
+
+//run work(0) .. work(tasks-1) on a pool of threadCount workers
+void runTasks(int tasks, const function<void(int)> &work)
+{
+    int workers = (threadCount > 0) ? threadCount : max(1u, thread::hardware_concurrency());
+    workers = min(workers, tasks);
+
+    atomic<int> nextTask(0);
+    vector<thread> pool;
+    for (int w = 0; w < workers; w++)
+    {
+        pool.push_back( thread([&]()
+        {
+            for (int t = nextTask++; t < tasks; t = nextTask++)
+                work(t);
+        }) );
+    }
+
+    for (int w = 0; w < pool.size(); w++)
+        pool[w].join();
+}
+
+
+
+
+//parse a comma separated list of positive numbers; false if any entry is not one
+bool parseScales(const string &text, vector<double> &scales)
+{
+    scales.clear();
+    const char *pos = text.c_str();
+    const char *end = pos + text.size();
+    while(pos <= end)
+    {
+        const char *comma = find(pos, end, ',');
+        double v;
+        if(!parseNumber(pos, comma, v) || !(v > 0))
+            return false;
+        scales.push_back(v);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+
+
+
+//print the sweep results: blocking probability of each selected policy in each scenario, averaged over replications
+void printSweep(const vector<Scenario> &scenarios, int replications, const deque<SimState> &states)
+{
+    printf("%-12s\t%-12s", "Capacity(x)", "Load(x)");
+    for (int k = 0; k < POLICY_COUNT; k++)
+    {
+        if(policySelected(policyTable[k].name))
+            printf("\t%-12s", (string(policyTable[k].name) + " Blk(%)").c_str());
+    }
+    printf("\n%-12s\n", "=========================================================================================================================");
+
+    for (int sc = 0; sc < scenarios.size(); sc++)
+    {
+        printf("%-12.2f\t%-12.2f", scenarios[sc].capacityScale, scenarios[sc].loadScale);
+        for (int k = 0; k < POLICY_COUNT; k++)
+        {
+            if(!policySelected(policyTable[k].name))
+                continue;
+
+            double blocked = 0;
+            for (int r = 0; r < replications; r++)
+                blocked += states[(sc * replications + r) * POLICY_COUNT + k].blockedPercent / replications;
+            printf("\t%-12.2f", blocked);
+        }
+        printf("\n");
+    }
+}
+
+
+
+
+
+
+
+//two-sided 95% Student t quantile for df degrees of freedom
+double tQuantile95(int df)
+{
+    static const double table[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    if(df <= 30)
+        return table[max(df, 1)];
+    return (df <= 60) ? 2.000 : (df <= 120) ? 1.980 : 1.960;
+}
+
+//mean and 95% confidence half-width of values
+pair<double,double> meanInterval(const vector<double> &values)
+{
+    int n = values.size();
+    double mean = 0;
+    for (int r = 0; r < n; r++)
+        mean += values[r] / n;
+    if(n < 2)
+        return make_pair(mean, 0.0);
+
+    double var = 0;
+    for (int r = 0; r < n; r++)
+        var += (values[r] - mean) * (values[r] - mean) / (n - 1);
+    return make_pair(mean, tQuantile95(n - 1) * sqrt(var / n));
+}
+
+//print the statistics of each selected policy over its replications (runs[k] holds policy k's states)
+void printReplications(const vector< vector<const SimState *> > &runs)
+{
+    printf("%-12s\t%-12s\t%-20s\t%-20s\t%-20s\t%-20s\n%-12s\n",
+        "Policy", "Replications", "Success(%)", "Blocked(%)", "Avg Hops", "Avg Delay",
+        "=========================================================================================================================");
+
+    for (int k = 0; k < POLICY_COUNT; k++)
+    {
+        if(!policySelected(policyTable[k].name))
+            continue;
+
+        vector<double> succ, blocked, hops, delay;
+        for (int r = 0; r < runs[k].size(); r++)
+        {
+            succ.push_back(runs[k][r]->succPercent);
+            blocked.push_back(runs[k][r]->blockedPercent);
+            hops.push_back(runs[k][r]->avgHop);
+            delay.push_back(runs[k][r]->avgProp);
+        }
+
+        pair<double,double> s = meanInterval(succ), b = meanInterval(blocked), h = meanInterval(hops), d = meanInterval(delay);
+        char cols[4][32];
+        snprintf(cols[0], sizeof(cols[0]), "%.2f +/- %.2f", s.first, s.second);
+        snprintf(cols[1], sizeof(cols[1]), "%.2f +/- %.2f", b.first, b.second);
+        snprintf(cols[2], sizeof(cols[2]), "%.4f +/- %.4f", h.first, h.second);
+        snprintf(cols[3], sizeof(cols[3]), "%.4f +/- %.4f", d.first, d.second);
+        printf("%-12s\t%-12d\t%-20s\t%-20s\t%-20s\t%-20s\n",
+            policyTable[k].name, (int)runs[k].size(), cols[0], cols[1], cols[2], cols[3]);
+    }
+}
+
+
+
+
+
+
+
+//start a new resident set high-water mark, so peakRssKb() measures what follows. False where the kernel
+//cannot reset it (then the mark is that of the process so far)
+bool resetPeakRss()
+{
+    FILE *refs = fopen("/proc/self/clear_refs", "w");
+    if(refs == NULL)
+        return false;
+    bool reset = (fputs("5", refs) >= 0);
+    return (fclose(refs) == 0) && reset;
+}
+
+//resident set high-water mark in KB, since resetPeakRss()
+long peakRssKb()
+{
+    FILE *status = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    while(status != NULL && kb < 0 && fgets(line, sizeof(line), status) != NULL)
+    {
+        if(strncmp(line, "VmHWM:", 6) == 0)
+            kb = atol(line + 6);
+    }
+    if(status != NULL)
+        fclose(status);
+    if(kb >= 0)
+        return kb;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+//measurements of one benchmark run
+class BenchResult
+{
+    public:
+        const char *policy;
+        int run;
+        double calls;
+        double runSeconds;          //whole run, reclaim and routing included
+        double callsPerSecond;
+        double routeMeanMicros;     //per call route search (and commit) latency
+        double routeP99Micros;
+        double reclaimSeconds;
+        long peakRssKb;             //during the run, if the mark could be reset before it (see runBenchmark)
+
+        BenchResult(const char *name, int r, double seconds, SimState &st) : policy(name), run(r), calls(st.totalCalls)
+        {
+            runSeconds = seconds;
+            callsPerSecond = (seconds > 0) ? calls / seconds : 0;
+            reclaimSeconds = st.reclaimNanos * 1e-9;
+
+            vector<float> &lat = st.routeNanos;
+            double total = 0;
+            for (int k = 0; k < lat.size(); k++)
+                total += lat[k];
+            routeMeanMicros = lat.empty() ? 0 : total / lat.size() * 1e-3;
+            routeP99Micros = 0;
+            if(!lat.empty())
+            {
+                size_t p = (size_t)(0.99 * (lat.size() - 1));
+                nth_element(lat.begin(), lat.begin() + p, lat.end());
+                routeP99Micros = lat[p] * 1e-3;
+            }
+            peakRssKb = ::peakRssKb();
+        }
+};
+
+//run each selected policy runs times, one run at a time so the timings do not compete for cores,
+//and print the measurements as text, json or csv
+void runBenchmark(int runs, const string &format, double loadSeconds)
+{
+    vector<BenchResult> results;
+    bool rssWarned = false;
+    for (int k = 0; k < POLICY_COUNT; k++)
+    {
+        if(!policySelected(policyTable[k].name))
+            continue;
+
+        for (int r = 0; r < runs; r++)
+        {
+            SimState st;
+            st.policy = policyTable[k].name;
+            st.timing = true;
+            if(!streaming && genConfig.generateCalls <= 0)
+                st.routeNanos.reserve(eventQueue.size());
+
+            //the peak of this run alone, not of the runs before it
+            if(!resetPeakRss() && !rssWarned)
+            {
+                cerr << "warning: cannot reset the peak RSS; it is reported for the process so far" << endl;
+                rssWarned = true;
+            }
+
+            int64_t start = clockNanos();
+            policyTable[k].run(st);
+            results.push_back( BenchResult(policyTable[k].name, r, (clockNanos() - start) * 1e-9, st) );
+        }
+    }
+
+    if(format == "json")
+    {
+        printf("{\"load_s\": %.6f, \"runs\": [", loadSeconds);
+        for (int k = 0; k < results.size(); k++)
+        {
+            const BenchResult &b = results[k];
+            printf("%s\n  {\"policy\": \"%s\", \"run\": %d, \"calls\": %.0f, \"run_s\": %.6f, \"calls_per_s\": %.1f, "
+                   "\"route_mean_us\": %.4f, \"route_p99_us\": %.4f, \"reclaim_s\": %.6f, \"peak_rss_kb\": %ld}",
+                   (k > 0) ? "," : "", b.policy, b.run, b.calls, b.runSeconds, b.callsPerSecond,
+                   b.routeMeanMicros, b.routeP99Micros, b.reclaimSeconds, b.peakRssKb);
+        }
+        printf("\n]}\n");
+    }
+    else if(format == "csv")
+    {
+        printf("policy,run,calls,load_s,run_s,calls_per_s,route_mean_us,route_p99_us,reclaim_s,peak_rss_kb\n");
+        for (int k = 0; k < results.size(); k++)
+        {
+            const BenchResult &b = results[k];
+            printf("%s,%d,%.0f,%.6f,%.6f,%.1f,%.4f,%.4f,%.6f,%ld\n", b.policy, b.run, b.calls, loadSeconds, b.runSeconds,
+                   b.callsPerSecond, b.routeMeanMicros, b.routeP99Micros, b.reclaimSeconds, b.peakRssKb);
+        }
+    }
+    else
+    {
+        printf("Load: %.4f s\n", loadSeconds);
+        printf("%-12s\t%-6s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\t%-12s\n%-12s\n",
+            "Policy", "Run", "Calls", "Run(s)", "Calls/s", "Route(us)", "Route p99", "Reclaim(s)", "Peak RSS(KB)",
+            "=========================================================================================================================");
+        for (int k = 0; k < results.size(); k++)
+        {
+            const BenchResult &b = results[k];
+            printf("%-12s\t%-6d\t%-12.0f\t%-12.4f\t%-12.0f\t%-12.4f\t%-12.4f\t%-12.4f\t%-12ld\n", b.policy, b.run, b.calls,
+                   b.runSeconds, b.callsPerSecond, b.routeMeanMicros, b.routeP99Micros, b.reclaimSeconds, b.peakRssKb);
+        }
+    }
+}
+
+
+
+
+
+
+
+///Main function////////////////////////////////////////////
+
+
+
+int main( int argc, char ** argv)
+{
+
+    //parse options
+    string topologyPath = "topology.dat";
+    bool sweep = false;
+    int replications = 1;
+    string matrixPath;
+    int benchRuns = 0;
+    bool workloadGiven = false;
+    string regionsPath;
+    string resumePath, forkPath;
+    string engine = "auto";
+    string sortPath;
+    long sortRunCalls = 1000000;
+    string windowPath;
+    TopologySpec topologySpec;
+    string makeTopologyPath, makeWorkloadPath;
+    long makeWorkloadCalls = 0;
+    vector<double> range;
+    string benchFormat = "text";
+    vector<double> capacityScales(1, 1.0);
+    vector<double> loadScales(1, 1.0);
+    for (int k = 1; k < argc; k++)
+    {
+        string arg = argv[k];
+        if(arg == "--stream")
+            streaming = true;
+        else if(arg == "--workload" && k+1 < argc)
+        {
+            //the first --workload replaces the default, later ones add workloads to merge
+            if(!workloadGiven)
+                workloadPaths.clear();
+            workloadGiven = true;
+            workloadPaths.push_back(argv[++k]);
+        }
+        else if(arg == "--sort-workload" && k+1 < argc)
+            sortPath = argv[++k];
+        else if(arg == "--sort-memory" && k+1 < argc)
+            sortRunCalls = atol(argv[++k]);
+        else if(arg == "--topology" && k+1 < argc)
+            topologyPath = argv[++k];
+        else if(arg == "--policy" && k+1 < argc)
+            policyName = argv[++k];
+        else if(arg == "--kpaths" && k+1 < argc)
+            kPaths = atoi(argv[++k]);
+        else if(arg == "--threads" && k+1 < argc)
+            threadCount = atoi(argv[++k]);
+        else if(arg == "--generate" && k+1 < argc)
+            genConfig.generateCalls = atol(argv[++k]);
+        else if(arg == "--rate" && k+1 < argc)
+            genConfig.arrivalRate = atof(argv[++k]);
+        else if(arg == "--holding" && k+1 < argc)
+            genConfig.meanHolding = atof(argv[++k]);
+        else if(arg == "--pareto" && k+1 < argc)
+            genConfig.paretoShape = atof(argv[++k]);
+        else if(arg == "--matrix" && k+1 < argc)
+            matrixPath = argv[++k];
+        else if(arg == "--seed" && k+1 < argc)
+            genConfig.seed = strtoull(argv[++k], NULL, 10);
+        else if(arg == "--replications" && k+1 < argc)
+            replications = atoi(argv[++k]);
+        else if(arg == "--window" && k+1 < argc)
+            windowWidth = atof(argv[++k]);
+        else if(arg == "--window-out" && k+1 < argc)
+            windowPath = argv[++k];
+        else if(arg == "--engine" && k+1 < argc)
+            engine = argv[++k];
+        else if(arg == "--batch" && k+1 < argc)
+            batchSize = atoi(argv[++k]);
+        else if(arg == "--shards" && k+1 < argc)
+            shardCount = atoi(argv[++k]);
+        else if(arg == "--regions" && k+1 < argc)
+            regionsPath = argv[++k];
+        else if(arg == "--checkpoint" && k+2 < argc)
+        {
+            checkpointEvery = atol(argv[++k]);
+            checkpointPath = argv[++k];
+        }
+        else if(arg == "--resume" && k+1 < argc)
+            resumePath = argv[++k];
+        else if(arg == "--fork" && k+1 < argc)
+            forkPath = argv[++k];
+        else if(arg == "--bench" && k+1 < argc)
+            benchRuns = atoi(argv[++k]);
+        else if(arg == "--bench-format" && k+1 < argc)
+            benchFormat = argv[++k];
+        else if((arg == "--sweep-capacity" || arg == "--sweep-load") && k+1 < argc)
+        {
+            sweep = true;
+            if(!parseScales(argv[++k], (arg == "--sweep-capacity") ? capacityScales : loadScales))
+            {
+                cerr << "error: " << arg << " takes a list of positive factors, e.g. 0.5,1,2" << endl;
+                return 1;
+            }
+        }
+        else if(arg == "--make-topology" && k+3 < argc)
+        {
+            topologySpec.kind = argv[++k];
+            topologySpec.size = atoi(argv[++k]);
+            makeTopologyPath = argv[++k];
+        }
+        else if(arg == "--make-workload" && k+2 < argc)
+        {
+            makeWorkloadCalls = atol(argv[++k]);
+            makeWorkloadPath = argv[++k];
+        }
+        else if(arg == "--attach" && k+1 < argc)
+            topologySpec.attach = atoi(argv[++k]);
+        else if((arg == "--link-capacity" || arg == "--link-delay") && k+1 < argc)
+        {
+            if(!parseScales(argv[++k], range) || range.size() > 2)
+            {
+                cerr << "error: " << arg << " takes MIN or MIN,MAX" << endl;
+                return 1;
+            }
+            double low = range[0], high = range.back();
+            if(arg == "--link-capacity")
+            {
+                topologySpec.capacityMin = (int)low;
+                topologySpec.capacityMax = max((int)low, (int)high);
+            }
+            else
+            {
+                topologySpec.delayMin = low;
+                topologySpec.delayMax = max(low, high);
+            }
+        }
+        else if(arg == "--convert" && k+2 < argc)
+        {
+            string inPath = argv[++k];
+            string outPath = argv[++k];
+            return convertTrace(inPath, outPath);
+        }
+        else
+        {
+            cerr << "usage: " << argv[0] << " [--topology FILE] [--workload FILE|-] [--stream] [--policy NAME] [--kpaths K]" << endl
+                 << "       " << "    [--threads N] [--sweep-capacity X,Y,..] [--sweep-load X,Y,..]" << endl
+                 << "       " << "    [--generate CALLS [--rate R] [--holding MEAN] [--pareto SHAPE] [--matrix FILE]"
+                 << " [--seed S] [--replications N]]" << endl
+                 << "       " << "    [--bench RUNS [--bench-format text|json|csv]] [--window MINUTES --window-out FILE]" << endl
+                 << "       " << "    [--shards N | --regions FILE] [--batch N] [--engine auto|sparse|dense]" << endl
+                 << "       " << "    [--checkpoint CALLS PREFIX] [--resume PREFIX | --fork SNAPSHOT]" << endl
+                 << "       " << argv[0] << " --convert WORKLOAD TRACE" << endl
+                 << "       " << argv[0] << " --sort-workload OUT --workload FILE [--workload FILE ..] [--sort-memory CALLS]" << endl
+                 << "       " << argv[0] << " --make-topology grid|geometric|ba|fattree SIZE FILE [--link-capacity MIN[,MAX]]"
+                 << " [--link-delay MIN[,MAX]] [--attach M] [--seed S]" << endl
+                 << "       " << argv[0] << " --make-workload CALLS FILE [--topology FILE] [--rate R] [--holding MEAN] [--pareto SHAPE]"
+                 << " [--matrix FILE] [--seed S]" << endl;
+            return 1;
+        }
+    }
+
+    if(!makeTopologyPath.empty())
+        return makeTopology(topologySpec, makeTopologyPath);
+    if(!sortPath.empty())
+        return sortWorkload(workloadPaths, sortPath, sortRunCalls);
+
+    //binary traces are always iterated in place, never copied into eventQueue. Check the header up front,
+    //before the modes that need a loaded workload are checked
+    bool stdinWorkload = false;
+    for (int w = 0; w < workloadPaths.size(); w++)
+    {
+        BinaryTrace checkTrace;
+        if(isBinaryTrace(workloadPaths[w]) && checkTrace.open(workloadPaths[w]))
+            streaming = true;
+        stdinWorkload = stdinWorkload || (workloadPaths[w] == "-");
+    }
+
+    //policy must be one of policyTable
+    bool knownPolicy = policyName.empty();
+    for (int k = 0; k < POLICY_COUNT; k++)
+        knownPolicy = knownPolicy || (policyName == policyTable[k].name);
+    if(!knownPolicy)
+    {
+        cerr << "error: unknown policy " << policyName << endl;
+        return 1;
+    }
+
+    //replications need a synthetic workload to differ
+    if(replications < 1 || (replications > 1 && genConfig.generateCalls <= 0))
+    {
+        cerr << "error: --replications needs --generate" << endl;
+        return 1;
+    }
+    if(genConfig.generateCalls > 0 && !(genConfig.arrivalRate > 0 && genConfig.meanHolding > 0))
+    {
+        cerr << "error: --rate and --holding must be positive" << endl;
+        return 1;
+    }
+
+    //a benchmark times single runs of the plain workload
+    if(benchRuns > 0 && (sweep || replications > 1))
+    {
+        cerr << "error: --bench cannot be combined with sweeps or replications" << endl;
+        return 1;
+    }
+    if(benchFormat != "text" && benchFormat != "json" && benchFormat != "csv")
+    {
+        cerr << "error: unknown benchmark format " << benchFormat << endl;
+        return 1;
+    }
+
+    if(engine != "auto" && engine != "sparse" && engine != "dense")
+    {
+        cerr << "error: unknown engine " << engine << endl;
+        return 1;
+    }
+
+    //sharded runs replay a loaded workload, one run at a time
+    bool sharded = (shardCount > 0 || !regionsPath.empty());
+    if(sharded && (streaming || genConfig.generateCalls > 0 || windowWidth > 0 || benchRuns > 0))
+    {
+        cerr << "error: --shards and --regions replay a loaded workload; they cannot be combined with"
+             << " --stream, binary traces, --generate, --window or --bench" << endl;
+        return 1;
+    }
+
+    //batched runs route with searches only, one run at a time
+    if(batchSize > 0 && (sharded || benchRuns > 0 || kPaths > 0))
+    {
+        cerr << "error: --batch cannot be combined with --shards, --regions, --bench or --kpaths" << endl;
+        return 1;
+    }
+
+    //snapshots are of plain runs of one network and workload
+    bool snapshots = (checkpointEvery != 0 || !resumePath.empty() || !forkPath.empty());
+    if(checkpointEvery < 0 || (!resumePath.empty() && !forkPath.empty()))
+    {
+        cerr << "error: --checkpoint takes a positive number of calls, and --resume and --fork exclude each other" << endl;
+        return 1;
+    }
+    if(snapshots && (sweep || replications > 1 || sharded || batchSize > 0 || benchRuns > 0))
+    {
+        cerr << "error: --checkpoint, --resume and --fork cannot be combined with sweeps, replications,"
+             << " --shards, --regions, --batch or --bench" << endl;
+        return 1;
+    }
+
+    //windows need somewhere to go
+    if(windowWidth < 0 || (windowWidth > 0) != !windowPath.empty())
+    {
+        cerr << "error: --window MINUTES and --window-out FILE go together" << endl;
+        return 1;
+    }
+    //a resumed run continues the rows of the run it resumes once its snapshots are read
+    if(windowWidth > 0 && resumePath.empty())
+    {
+        windowOut = fopen(windowPath.c_str(), "w");
+        if(windowOut == NULL)
+        {
+            cerr << "error: cannot write " << windowPath << endl;
+            return 1;
+        }
+        writeWindowHeader(windowOut);
+    }
+
+    //stdin can only be streamed once
+    if(streaming && stdinWorkload && (policyName.empty() || sweep || benchRuns > 1))
+    {
+        cerr << "error: streaming from stdin runs a single policy and no sweep; choose one with --policy" << endl;
+        return 1;
+    }
+
+
+    int64_t loadStart = clockNanos();
+
+//Load in the topology file
+    if(!loadTopology(topologyPath))
+    {
+        cout << "error" << endl;
+    }
+
+
+//Load in the traffic matrix for generated calls
+    if(!matrixPath.empty() && !loadTrafficMatrix(matrixPath))
+    {
+        cerr << "error: cannot read " << matrixPath << endl;
+        return 1;
+    }
+    if((genConfig.generateCalls > 0 || !makeWorkloadPath.empty()) && genConfig.pairs.empty() && nodeNames.size() < 2)
+    {
+        cerr << "error: generating calls needs at least 2 nodes" << endl;
+        return 1;
+    }
+
+    if(!makeWorkloadPath.empty())
+        return makeWorkload(makeWorkloadCalls, makeWorkloadPath);
+
+//Load in the Calls file (unless it is streamed on each run, or calls are generated)
+    //Loaded workloads need not be in time order: they are put in order once read, as the merge of
+    //several streams would (equal times keep file order)
+    if(!streaming && genConfig.generateCalls <= 0)
+    {
+        CallEvent call;
+        for (int w = 0; w < workloadPaths.size(); w++)
+        {
+            WorkloadReader reader;
+            if(!reader.open(workloadPaths[w], false))
+                break;
+            //while !EOF
+            while(reader.next(call))
+            {
+                //add event to queue
+                eventQueue.push_back(call);
+            }
+        }
+        eventQueue.sortByArrival();
+    }
+
+
+
+///////Run the algorithms////////////////////////////////////////////////////
+
+
+
+
+
+//regions of sharded runs
+    if(!regionsPath.empty() && !loadRegions(regionsPath))
+    {
+        cerr << "error: cannot read " << regionsPath << endl;
+        return 1;
+    }
+    if(sharded)
+    {
+        if(regionsPath.empty())
+            partitionRegions();
+        if(!regionsComplete())
+        {
+            cerr << "error: some nodes are in no region" << endl;
+            return 1;
+        }
+        assignLinkRegions();
+        int trunks = count(linkRegion.begin(), linkRegion.end(), -1);
+        cerr << shardCount << " regions, " << trunks << " trunk links of " << links.size() << endl;
+    }
+
+//search engine for the topology
+    chooseEngine(engine);
+    if(denseEngine)
+        chooseDenseSearches();
+
+    if(benchRuns > 0)
+    {
+        runBenchmark(benchRuns, benchFormat, (clockNanos() - loadStart) * 1e-9);
+        return 0;
+    }
+
+//one independent state per policy and scenario; the runs go to a thread pool over the shared, read-only call trace
+    vector<Scenario> scenarios;
+    for (int c = 0; c < capacityScales.size(); c++)
+    {
+        for (int l = 0; l < loadScales.size(); l++)
+            scenarios.push_back( Scenario(capacityScales[c], loadScales[l]) );
+    }
+
+    //states[(scenario * replications + replication) * POLICY_COUNT + policy]
+    deque<SimState> states;
+    vector<int> runs;           //(elem- index into states of a run to do)
+    for (int sc = 0; sc < scenarios.size(); sc++)
+    {
+        for (int r = 0; r < replications; r++)
+        {
+            for (int k = 0; k < POLICY_COUNT; k++)
+            {
+                states.emplace_back(scenarios[sc], r);
+                states.back().policy = policyTable[k].name;
+                if(policySelected(policyTable[k].name))
+                    runs.push_back(states.size() - 1);
+            }
+        }
+    }
+
+    //runs resuming from their own last snapshot (starting afresh if they wrote none), or all forked from one
+    for (int t = 0; t < runs.size(); t++)
+    {
+        SimState &st = states[runs[t]];
+        if(!resumePath.empty() && !readSnapshot(st, resumePath + "." + st.policy))
+            cerr << "no snapshot " << resumePath << "." << st.policy << ", " << st.policy << " starts from call 0" << endl;
+        if(!forkPath.empty() && !readSnapshot(st, forkPath))
+        {
+            cerr << "error: cannot read " << forkPath << endl;
+            return 1;
+        }
+    }
+    if(windowWidth > 0 && !resumePath.empty())
+    {
+        vector<const SimState *> resumed;
+        for (int t = 0; t < runs.size(); t++)
+            resumed.push_back(&states[runs[t]]);
+        windowOut = resumeWindows(windowPath, resumed);
+        if(windowOut == NULL)
+        {
+            cerr << "error: cannot rewrite " << windowPath << endl;
+            return 1;
+        }
+    }
+
+    //sharded and batched runs use the threads themselves
+    if(sharded || batchSize > 0)
+    {
+        for (int t = 0; t < runs.size(); t++)
+        {
+            const PolicyEntry &policy = policyTable[runs[t] % POLICY_COUNT];
+            (sharded ? policy.runSharded : policy.runBatched)(states[runs[t]]);
+        }
+    }
+    else
+    {
+        runTasks(runs.size(), [&](int t)
+        {
+            policyTable[runs[t] % POLICY_COUNT].run(states[runs[t]]);
+        });
+    }
+
+    if(sweep)
+    {
+        printSweep(scenarios, replications, states);
+        return 0;
+    }
+
+    if(replications > 1)
+    {
+        vector< vector<const SimState *> > byPolicy(POLICY_COUNT);
+        for (int r = 0; r < replications; r++)
+        {
+            for (int k = 0; k < POLICY_COUNT; k++)
+                byPolicy[k].push_back(&states[r * POLICY_COUNT + k]);
+        }
+        printReplications(byPolicy);
+        return 0;
+    }
+
+///print titles
+    printInit();
+
+    //print statistics in policy order
+    for (int k = 0; k < POLICY_COUNT; k++)
+    {
+        if(policySelected(policyTable[k].name))
+            printRes(policyTable[k].name, states[k]);
+    }
+    for (int k = 0; k < POLICY_COUNT; k++)
+    {
+        if(policySelected(policyTable[k].name))
+            printCounters(policyTable[k].name, states[k]);
+    }
+}//end mian